@@ -139,6 +139,53 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
   block->write_cnt++;
 }
 
+/* Reads the CNT consecutive sectors starting at SECTOR from BLOCK,
+   sector I into BUFFERS[I], each of which must have room for
+   BLOCK_SECTOR_SIZE bytes.  Devices that support it transfer the
+   run with as few commands as they can, others one sector at a
+   time.  Internally synchronizes accesses to block devices, so
+   external per-block device locking is unneeded. */
+void
+block_read_multi (struct block *block, block_sector_t sector,
+                  void *const buffers[], size_t cnt)
+{
+  size_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  if (block->ops->read_multi != NULL)
+    block->ops->read_multi (block->aux, sector, buffers, cnt);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->read (block->aux, sector + i, buffers[i]);
+  block->read_cnt += cnt;
+}
+
+/* Writes the CNT consecutive sectors starting at SECTOR to BLOCK,
+   sector I from BUFFERS[I], as block_read_multi() reads them.
+   Returns after the block device has acknowledged receiving the
+   data. */
+void
+block_write_multi (struct block *block, block_sector_t sector,
+                   const void *const buffers[], size_t cnt)
+{
+  size_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  if (block->ops->write_multi != NULL)
+    block->ops->write_multi (block->aux, sector, buffers, cnt);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->write (block->aux, sector + i, buffers[i]);
+  block->write_cnt += cnt;
+}
+
 /* Returns the number of sectors in BLOCK. */
 block_sector_t
 block_size (struct block *block)
@@ -0,0 +1,71 @@
+/* vmstat.c
+
+   Prints the kernel's virtual memory statistics. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+static const char *class_names[FAULT_CLASS_CNT] =
+  {"zero", "swap", "file", "stack", "cow"};
+
+int
+main (void) 
+{
+  struct vmstat s;
+  struct faultstat fs;
+  int c, i;
+
+  if (!vmstat (&s))
+    {
+      printf ("vmstat: system call failed\n");
+      return EXIT_FAILURE;
+    }
+
+  printf ("page faults:  %10lld\n", s.faults);
+  printf ("  stack:      %10lld\n", s.stack_faults);
+  printf ("  file:       %10lld\n", s.file_faults);
+  printf ("  swap:       %10lld\n", s.swap_faults);
+  printf ("  zero:       %10lld\n", s.zero_faults);
+  printf ("  invalid:    %10lld\n", s.invalid_faults);
+  printf ("stack ahead:  %10lld\n", s.stack_ahead);
+  printf ("faulted around: %8lld\n", s.fault_around);
+  printf ("shared maps:  %10lld\n", s.shared_maps);
+  printf ("cow faults:   %10lld\n", s.cow_faults);
+  printf ("merged pages: %10lld\n", s.merged_pages);
+  printf ("evictions:\n");
+  printf ("  clean:      %10lld\n", s.clean_evictions);
+  printf ("  dirty:      %10lld\n", s.dirty_evictions);
+  printf ("swap slots:   %10u of %u in use\n",
+          s.swap_slots_used, s.swap_slots);
+  printf ("swap sectors: %10lld read, %lld written\n",
+          s.swap_reads, s.swap_writes);
+  printf ("swap commands: %9lld read, %lld written\n",
+          s.swap_read_cmds, s.swap_write_cmds);
+  printf ("swap readahead: %8lld pages\n", s.swap_readahead);
+  printf ("swap cached:  %10lld pages\n", s.swap_cached);
+  printf ("compressed swap: %7lld stored (%lld same-filled), "
+          "%lld loaded, %lld written to disk\n",
+          s.zswap_stores, s.zswap_same, s.zswap_loads, s.zswap_writebacks);
+
+  if (!faultstat (&fs))
+    {
+      printf ("faultstat: system call failed\n");
+      return EXIT_FAILURE;
+    }
+  printf ("fault latency (mean cycles, log2 histogram):\n");
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    {
+      long long cnt = 0;
+
+      for (i = 0; i < FAULT_LAT_BUCKETS; i++)
+        cnt += fs.hist[c][i];
+      if (cnt == 0)
+        continue;
+      printf ("  %-6s %10lld", class_names[c], fs.cycles[c] / cnt);
+      for (i = 0; i < FAULT_LAT_BUCKETS; i++)
+        if (fs.hist[c][i] != 0)
+          printf (" 2^%d:%u", i, fs.hist[c][i]);
+      printf ("\n");
+    }
+  return EXIT_SUCCESS;
+}
@@ -28,7 +28,17 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Virtual memory extensions. */
+    SYS_SETRSS,                 /* Limit this process's resident set. */
+    SYS_VMSTAT,                 /* Report virtual memory statistics. */
+    SYS_FORK,                   /* Duplicate the current process. */
+    SYS_SETSTACK,               /* Set stack reservation for exec. */
+    SYS_MADVISE,                /* Give access pattern hints. */
+    SYS_MMAP_RANGE,             /* Map part of a file into memory. */
+    SYS_MSYNC,                  /* Write back mapped file pages. */
+    SYS_FAULTSTAT               /* Report page fault latencies. */
   };
 
 #endif /* lib/syscall-nr.h */
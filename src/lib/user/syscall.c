@@ -61,6 +61,26 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER, passing arguments ARG0 through ARG4,
+   and returns the return value as an `int'. */
+#define syscall5(NUMBER, ARG0, ARG1, ARG2, ARG3, ARG4)          \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg4]; pushl %[arg3]; pushl %[arg2]; "    \
+             "pushl %[arg1]; pushl %[arg0]; "                   \
+             "pushl %[number]; int $0x30; addl $24, %%esp"      \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3),                             \
+                 [arg4] "r" (ARG4)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
 void
 halt (void) 
 {
@@ -182,3 +202,51 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+setrss (unsigned max_pages)
+{
+  return syscall1 (SYS_SETRSS, max_pages);
+}
+
+bool
+vmstat (struct vmstat *stats)
+{
+  return syscall1 (SYS_VMSTAT, stats);
+}
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+bool
+setstack (unsigned pages)
+{
+  return syscall1 (SYS_SETSTACK, pages);
+}
+
+bool
+madvise (void *addr, unsigned length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+mapid_t
+mmap_range (int fd, void *addr, unsigned offset, unsigned length, int flags)
+{
+  return syscall5 (SYS_MMAP_RANGE, fd, addr, offset, length, flags);
+}
+
+bool
+msync (void *addr, unsigned length)
+{
+  return syscall2 (SYS_MSYNC, addr, length);
+}
+
+bool
+faultstat (struct faultstat *stats)
+{
+  return syscall1 (SYS_FAULTSTAT, stats);
+}
@@ -12,6 +12,70 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* Flags for mmap_range(). */
+#define MAP_SHARED  0           /* Write changes back to the file. */
+#define MAP_PRIVATE 1           /* Keep changes private to the process. */
+
+/* Virtual memory statistics returned by vmstat(). */
+struct vmstat
+  {
+    long long faults;           /* Page faults, all kinds. */
+    long long stack_faults;     /* ...that grew the stack. */
+    long long file_faults;      /* ...that read a page from a file. */
+    long long swap_faults;      /* ...that read a page from swap. */
+    long long zero_faults;      /* ...that zero-filled a page. */
+    long long invalid_faults;   /* ...that hit no valid page. */
+    long long stack_ahead;      /* Stack pages grown ahead of a fault. */
+    long long fault_around;     /* Pages mapped ahead of a file fault. */
+    long long shared_maps;      /* Pages given another process's frame. */
+    long long cow_faults;       /* Writes to copy-on-write pages. */
+    long long clean_evictions;  /* Evictions that needed no I/O. */
+    long long dirty_evictions;  /* Evictions that wrote the page out. */
+    unsigned swap_slots_used;   /* Swap slots in use. */
+    unsigned swap_slots;        /* Total swap slots. */
+    long long swap_reads;       /* Sectors read from swap. */
+    long long swap_writes;      /* Sectors written to swap. */
+    long long swap_read_cmds;   /* Device commands that read them. */
+    long long swap_write_cmds;  /* Device commands that wrote them. */
+    long long swap_readahead;   /* Pages read ahead of a swap fault. */
+    long long swap_cached;      /* Pages swapped in that kept their slot. */
+    long long zswap_stores;     /* Pages swapped out to memory, compressed. */
+    long long zswap_same;       /* ...of which filled with one word. */
+    long long zswap_loads;      /* Pages swapped in from memory. */
+    long long zswap_writebacks; /* Pages moved from memory to the device. */
+    long long merged_pages;     /* Pages merged into identical frames. */
+  };
+
+/* Page fault classes, for faultstat(). */
+enum fault_class
+  {
+    FAULT_ZERO,                 /* Zero-filled an anonymous page. */
+    FAULT_SWAP,                 /* Read a page back from swap. */
+    FAULT_FILE,                 /* Read a page from a file. */
+    FAULT_STACK,                /* Grew the stack. */
+    FAULT_COW,                  /* Gave a copy-on-write page its own copy. */
+    FAULT_CLASS_CNT
+  };
+
+/* Page fault latency histograms returned by faultstat().  Bucket I
+   of a class counts its faults that took from 2**I to 2**(I+1) - 1
+   timestamp counter cycles; the last bucket also counts slower
+   ones. */
+#define FAULT_LAT_BUCKETS 32
+struct faultstat
+  {
+    unsigned hist[FAULT_CLASS_CNT][FAULT_LAT_BUCKETS];
+    long long cycles[FAULT_CLASS_CNT];  /* Total cycles per class. */
+  };
+
+/* Access pattern hints for madvise(). */
+#define MADV_NORMAL     0       /* No particular pattern. */
+#define MADV_RANDOM     1       /* Random access: no readahead. */
+#define MADV_SEQUENTIAL 2       /* Sequential access: read ahead,
+                                   drop pages behind. */
+#define MADV_WILLNEED   3       /* Will be used soon: bring it in now. */
+#define MADV_DONTNEED   4       /* Not needed: free its memory now. */
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -37,6 +101,9 @@ void close (int fd);
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
+mapid_t mmap_range (int fd, void *addr, unsigned offset, unsigned length,
+                    int flags);
+bool msync (void *addr, unsigned length);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -45,4 +112,12 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Virtual memory extensions. */
+bool setrss (unsigned max_pages);
+bool vmstat (struct vmstat *);
+pid_t fork (void);
+bool setstack (unsigned pages);
+bool madvise (void *addr, unsigned length, int advice);
+bool faultstat (struct faultstat *);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,16 @@
+/* Child process for pt-setstack test.
+   Writes 200 kB below the stack pointer, inside the stack its
+   parent reserved with setstack(). */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char here;
+  volatile char *p = &here - 200 * 1024;
+
+  *p = 1;
+  msg ("wrote 200 kB below the stack pointer");
+}
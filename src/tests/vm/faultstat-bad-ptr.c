@@ -0,0 +1,13 @@
+/* Passes faultstat() a buffer at PHYS_BASE.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  faultstat ((struct faultstat *) 0xc0000000);
+  fail ("should not have survived faultstat()");
+}
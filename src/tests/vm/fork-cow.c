@@ -0,0 +1,39 @@
+/* Forks a child, which shares the parent's pages copy-on-write,
+   and verifies that neither process sees the other's writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 4096)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  memset (buf, 'p', SIZE);
+  child = fork ();
+  if (child == 0)
+    {
+      /* The parent's writes after fork() must not show through. */
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 'p')
+          fail ("child sees byte %zu as '%c' instead of 'p'", i, buf[i]);
+      memset (buf, 'c', SIZE);
+      exit (81);
+    }
+  if (child == -1)
+    fail ("fork");
+
+  memset (buf, 'q', SIZE / 2);
+  CHECK (wait (child) == 81, "wait for child");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (i < SIZE / 2 ? 'q' : 'p'))
+      fail ("parent sees byte %zu as '%c' after child wrote", i, buf[i]);
+  msg ("parent's data unchanged by child");
+}
@@ -0,0 +1,35 @@
+/* Maps a file, forks, and verifies that the child does not inherit
+   the mapping while the parent's stays intact. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x54321000;
+  int handle;
+  pid_t child;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (handle, actual) != MAP_FAILED, "mmap \"sample.txt\"");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+
+  child = fork ();
+  if (child == 0)
+    {
+      /* Must be killed. */
+      actual[0] = 'x';
+      fail ("child can modify parent's memory mapping");
+    }
+  if (child == -1)
+    fail ("fork");
+
+  CHECK (wait (child) == -1, "wait for child (should return -1)");
+  CHECK (!memcmp (actual, sample, strlen (sample)),
+         "checking that mmap'd file still has same data");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(fork-mmap) begin
+(fork-mmap) open "sample.txt"
+(fork-mmap) mmap "sample.txt"
+fork-mmap: exit(-1)
+(fork-mmap) wait for child (should return -1)
+(fork-mmap) checking that mmap'd file still has same data
+(fork-mmap) end
+fork-mmap: exit(0)
+EOF
+pass;
@@ -0,0 +1,24 @@
+/* Passes madvise() an unknown advice value and ranges outside user
+   memory, each of which must fail without killing the process. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_SIZE];
+
+void
+test_main (void)
+{
+  CHECK (!madvise (buf, sizeof buf, 99), "unknown advice fails");
+  CHECK (!madvise (buf, sizeof buf, -1), "negative advice fails");
+  CHECK (!madvise ((void *) 0x1000, PAGE_SIZE, MADV_DONTNEED),
+         "range below user code fails");
+  CHECK (!madvise ((void *) (0xc0000000 - PAGE_SIZE), 2 * PAGE_SIZE,
+                   MADV_DONTNEED),
+         "range past PHYS_BASE fails");
+  CHECK (!madvise ((void *) 0xc0000000, PAGE_SIZE, MADV_WILLNEED),
+         "range at PHYS_BASE fails");
+}
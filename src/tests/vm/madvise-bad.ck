@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(madvise-bad) begin
+(madvise-bad) unknown advice fails
+(madvise-bad) negative advice fails
+(madvise-bad) range below user code fails
+(madvise-bad) range past PHYS_BASE fails
+(madvise-bad) range at PHYS_BASE fails
+(madvise-bad) end
+madvise-bad: exit(0)
+EOF
+pass;
@@ -0,0 +1,53 @@
+/* Writes to an anonymous page and to a page of a MAP_PRIVATE file
+   mapping, forces the file page out to swap by paging against a
+   small resident set, and calls madvise() with MADV_DONTNEED on
+   both.  The anonymous page must read back as zeros and the file
+   page as the file's data, not as the process's discarded writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define PAGE_SIZE 4096
+
+/* Smallest nonzero resident set limit the kernel accepts. */
+#define RSS_LIMIT_MIN 16
+
+static char anon[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static char filler[4 * RSS_LIMIT_MIN][PAGE_SIZE];
+
+void
+test_main (void)
+{
+  int handle;
+  size_t i;
+
+  memset (anon, 'a', PAGE_SIZE);
+  CHECK (madvise (anon, PAGE_SIZE, MADV_DONTNEED),
+         "madvise anonymous page MADV_DONTNEED");
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (anon[i] != 0)
+      fail ("byte %zu of anonymous page is %d instead of 0", i, anon[i]);
+  msg ("anonymous page reads back as zeros");
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap_range (handle, ACTUAL, 0, strlen (sample), MAP_PRIVATE)
+         != MAP_FAILED, "mmap \"sample.txt\" private");
+  memset (ACTUAL, 'x', strlen (sample));
+
+  /* Push the written page out to swap. */
+  CHECK (setrss (RSS_LIMIT_MIN), "setrss (RSS_LIMIT_MIN)");
+  for (i = 0; i < sizeof filler / PAGE_SIZE; i++)
+    filler[i][0] = i;
+  CHECK (setrss (0), "setrss (0)");
+
+  CHECK (madvise (ACTUAL, strlen (sample), MADV_DONTNEED),
+         "madvise file page MADV_DONTNEED");
+  if (memcmp (ACTUAL, sample, strlen (sample)))
+    fail ("file page does not read back as the file's data");
+  msg ("file page reads back as the file's data");
+  close (handle);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-dontneed) begin
+(madvise-dontneed) madvise anonymous page MADV_DONTNEED
+(madvise-dontneed) anonymous page reads back as zeros
+(madvise-dontneed) open "sample.txt"
+(madvise-dontneed) mmap "sample.txt" private
+(madvise-dontneed) setrss (RSS_LIMIT_MIN)
+(madvise-dontneed) setrss (0)
+(madvise-dontneed) madvise file page MADV_DONTNEED
+(madvise-dontneed) file page reads back as the file's data
+(madvise-dontneed) end
+EOF
+pass;
@@ -0,0 +1,30 @@
+/* Writes to a file through a MAP_PRIVATE mapping and verifies that
+   the process sees its writes but the file does not. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap_range (handle, ACTUAL, 0, strlen (sample),
+                            MAP_PRIVATE)) != MAP_FAILED,
+         "mmap \"sample.txt\" private");
+  memset (ACTUAL, 'x', strlen (sample));
+  CHECK (msync (ACTUAL, strlen (sample)), "msync private mapping");
+  CHECK (ACTUAL[0] == 'x' && ACTUAL[strlen (sample) - 1] == 'x',
+         "private writes are visible to the process");
+  munmap (map);
+  close (handle);
+
+  check_file ("sample.txt", sample, strlen (sample));
+}
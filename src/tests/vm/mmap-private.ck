@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-private) begin
+(mmap-private) open "sample.txt"
+(mmap-private) mmap "sample.txt" private
+(mmap-private) msync private mapping
+(mmap-private) private writes are visible to the process
+(mmap-private) open "sample.txt" for verification
+(mmap-private) verified contents of "sample.txt"
+(mmap-private) close "sample.txt"
+(mmap-private) end
+EOF
+pass;
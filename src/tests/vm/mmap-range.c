@@ -0,0 +1,31 @@
+/* Maps the second page of a two-page file with mmap_range() and
+   verifies that the mapping starts at that offset. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+
+static char buf[2 * 4096];
+
+void
+test_main (void)
+{
+  int handle;
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = i < 4096 ? 'a' : 'b' + i % 7;
+  CHECK (create ("data", sizeof buf), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (write (handle, buf, sizeof buf) == (int) sizeof buf,
+         "write \"data\"");
+  CHECK (mmap_range (handle, ACTUAL, 4096, 4096, MAP_SHARED) != MAP_FAILED,
+         "mmap second page of \"data\"");
+  CHECK (!memcmp (ACTUAL, buf + 4096, 4096),
+         "compare mapped data against second page");
+  CHECK (mmap_range (handle, ACTUAL + 4096, 3 * 4096, 4096, MAP_SHARED)
+         == MAP_FAILED, "try to mmap past end of \"data\" (must fail)");
+}
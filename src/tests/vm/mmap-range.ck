@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-range) begin
+(mmap-range) create "data"
+(mmap-range) open "data"
+(mmap-range) write "data"
+(mmap-range) mmap second page of "data"
+(mmap-range) compare mapped data against second page
+(mmap-range) try to mmap past end of "data" (must fail)
+(mmap-range) end
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Recurses deep enough to grow the stack by about a megabyte, one
+   frame of about a kilobyte at a time, checking on the way back up
+   that every frame kept its data.  Faults landing just below the
+   previous growth must make the kernel grow the stack several
+   pages at a time. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DEPTH 1024
+#define FRAME_SIZE 1000
+
+static unsigned
+recurse (int depth)
+{
+  volatile unsigned char frame[FRAME_SIZE];
+  unsigned sum;
+
+  frame[0] = frame[FRAME_SIZE - 1] = depth;
+  if (depth == 0)
+    return 0;
+  sum = recurse (depth - 1);
+  if (frame[0] != (unsigned char) depth
+      || frame[FRAME_SIZE - 1] != (unsigned char) depth)
+    fail ("frame at depth %d was overwritten", depth);
+  return sum + frame[0];
+}
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  unsigned expected = 0;
+  int i;
+
+  for (i = 1; i <= DEPTH; i++)
+    expected += (unsigned char) i;
+
+  vmstat (&before);
+  CHECK (recurse (DEPTH) == expected, "recurse to depth %d", DEPTH);
+  vmstat (&after);
+  CHECK (after.stack_ahead > before.stack_ahead,
+         "stack grew ahead of faults");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pt-grow-deep) begin
+(pt-grow-deep) recurse to depth 1024
+(pt-grow-deep) stack grew ahead of faults
+(pt-grow-deep) end
+EOF
+pass;
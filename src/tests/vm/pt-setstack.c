@@ -0,0 +1,22 @@
+/* Checks that setstack() refuses more stack than STACK_LIMIT and
+   that a reservation it accepts carries over to exec(): the child
+   writes far below its stack pointer, which would kill a process
+   with the default stack. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Maximum size of a process's stack, as in the kernel. */
+#define STACK_LIMIT (8 * 1024 * 1024)
+#define PAGE_SIZE 4096
+
+void
+test_main (void)
+{
+  CHECK (!setstack (STACK_LIMIT / PAGE_SIZE + 1),
+         "setstack over STACK_LIMIT fails");
+  CHECK (setstack (64), "setstack (64)");
+  CHECK (wait (exec ("child-setstack")) == 0, "wait for child");
+  CHECK (setstack (0), "setstack (0)");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pt-setstack) begin
+(pt-setstack) setstack over STACK_LIMIT fails
+(pt-setstack) setstack (64)
+(child-setstack) begin
+(child-setstack) wrote 200 kB below the stack pointer
+(child-setstack) end
+child-setstack: exit(0)
+(pt-setstack) wait for child
+(pt-setstack) setstack (0)
+(pt-setstack) end
+pt-setstack: exit(0)
+EOF
+pass;
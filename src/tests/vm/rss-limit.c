@@ -0,0 +1,45 @@
+/* Limits the process's resident set to a few pages, writes a
+   distinct pattern to many more pages than that, and verifies that
+   every page reads back intact after being evicted from the
+   process's own resident set.  Also checks that limits too small to
+   make progress with are refused. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Smallest nonzero limit the kernel accepts. */
+#define RSS_LIMIT_MIN 16
+
+#define PAGE_CNT (4 * RSS_LIMIT_MIN)
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_CNT][PAGE_SIZE];
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  size_t i, j;
+
+  CHECK (!setrss (1), "setrss (1) fails");
+  CHECK (!setrss (RSS_LIMIT_MIN - 1), "setrss (RSS_LIMIT_MIN - 1) fails");
+  CHECK (setrss (RSS_LIMIT_MIN), "setrss (RSS_LIMIT_MIN)");
+
+  vmstat (&before);
+  for (i = 0; i < PAGE_CNT; i++)
+    for (j = 0; j < PAGE_SIZE; j++)
+      buf[i][j] = i + j;
+  for (i = 0; i < PAGE_CNT; i++)
+    for (j = 0; j < PAGE_SIZE; j++)
+      if (buf[i][j] != (char) (i + j))
+        fail ("byte %zu of page %zu is %d instead of %d",
+              j, i, buf[i][j], (char) (i + j));
+  msg ("all pages intact");
+  vmstat (&after);
+
+  CHECK (after.clean_evictions + after.dirty_evictions
+         > before.clean_evictions + before.dirty_evictions,
+         "pages were evicted");
+  CHECK (setrss (0), "setrss (0)");
+}
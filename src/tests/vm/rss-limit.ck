@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rss-limit) begin
+(rss-limit) setrss (1) fails
+(rss-limit) setrss (RSS_LIMIT_MIN - 1) fails
+(rss-limit) setrss (RSS_LIMIT_MIN)
+(rss-limit) all pages intact
+(rss-limit) pages were evicted
+(rss-limit) setrss (0)
+(rss-limit) end
+rss-limit: exit(0)
+EOF
+pass;
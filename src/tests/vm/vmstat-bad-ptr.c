@@ -0,0 +1,13 @@
+/* Passes vmstat() a buffer whose last bytes lie above PHYS_BASE.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  vmstat ((struct vmstat *) (0xc0000000 - 4));
+  fail ("should not have survived vmstat()");
+}
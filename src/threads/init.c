@@ -37,6 +37,12 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/merge.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -57,6 +63,18 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+#ifdef VM
+/* -vm-low, -vm-high: Free frame watermarks for background reclaim. */
+static size_t frame_low_wm = SIZE_MAX;
+static size_t frame_high_wm = SIZE_MAX;
+
+/* -vm-stack: Stack pages reserved for each new process. */
+static size_t stack_reserve_pages = 1;
+
+/* -vm-zswap: Kernel pages for compressed swapped-out pages. */
+static size_t zswap_pages = SIZE_MAX;
+#endif
+
 static void bss_init (void);
 static void paging_init (void);
 
@@ -127,6 +145,14 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  page_init (stack_reserve_pages);
+  swap_init (zswap_pages);
+  frame_init (frame_low_wm, frame_high_wm);
+  merge_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -150,16 +176,60 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* CR4 bits that enable 4 MB pages and global pages.  See
+   [IA32-v3a] 2.5 "Control Registers". */
+#define CR4_PSE 0x00000010
+#define CR4_PGE 0x00000080
+
+/* Feature flags that CPUID function 1 returns in EDX.  See
+   [IA32-v2a] "CPUID--CPU Identification". */
+#define CPUID_PSE (1u << 3)     /* 4 MB pages. */
+#define CPUID_PGE (1u << 13)    /* Global pages. */
+
+/* Returns the feature flags that CPUID function 1 reports in EDX. */
+static uint32_t
+cpu_features (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return edx;
+}
+
+/* Sets BITS in control register CR4. */
+static void
+cr4_set (uint32_t bits)
+{
+  uint32_t cr4;
+
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4 | bits) : "memory");
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports it, each whole 4 MB of physical memory
+   that holds no kernel text is mapped by a single large-page PDE
+   instead of a page table, so that the kernel's accesses to it,
+   such as copies to and from user frames, take far fewer TLB
+   entries.  Kernel text keeps 4 kB read-only pages.  Kernel
+   mappings are also made global where supported, so that they
+   survive the CR3 reload on every switch between processes. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  uint32_t features = cpu_features ();
+  bool pse = (features & CPUID_PSE) != 0;
+  uint32_t global = features & CPUID_PGE ? PTE_G : 0;
+
+  if (pse)
+    cr4_set (CR4_PSE);
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -171,13 +241,22 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0
+          && page + PTSPAN / PGSIZE <= init_ram_pages
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large_kernel (vaddr, true) | global;
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
     }
 
   /* Store the physical address of the page directory into CR3
@@ -186,6 +265,8 @@ paging_init (void)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+  if (global)
+    cr4_set (CR4_PGE);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -250,6 +331,19 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-vm-policy"))
+        {
+          if (value == NULL || !frame_set_policy (value))
+            PANIC ("unknown page replacement policy `%s'", value);
+        }
+      else if (!strcmp (name, "-vm-low"))
+        frame_low_wm = atoi (value);
+      else if (!strcmp (name, "-vm-high"))
+        frame_high_wm = atoi (value);
+      else if (!strcmp (name, "-vm-stack"))
+        stack_reserve_pages = atoi (value);
+      else if (!strcmp (name, "-vm-zswap"))
+        zswap_pages = atoi (value);
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
@@ -376,6 +470,13 @@ usage (void)
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -vm-policy=POLICY  Evict pages with POLICY: clock (default),\n"
+          "                     lru-approx, clock-pro, or fifo.\n"
+          "  -vm-low=COUNT      Reclaim frames when fewer than COUNT are free.\n"
+          "  -vm-high=COUNT     Reclaim until COUNT frames are free.\n"
+          "  -vm-stack=COUNT    Reserve COUNT stack pages for each process.\n"
+          "  -vm-zswap=COUNT    Keep up to COUNT pages of compressed swap in\n"
+          "                     memory (0 to disable).\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
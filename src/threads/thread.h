@@ -125,7 +125,23 @@ struct thread
 #endif
 
     /* Pages owned by the thread */
-    struct hash *pages;                 /* Page table. */
+    struct page_table *pages;           /* Page table. */
+
+    /* Resident set, owned by vm/frame.c and protected by its
+       scan_lock. */
+    struct list frames;                 /* Resident frames. */
+    size_t resident_cnt;                /* Number of resident frames. */
+    size_t rss_limit;                   /* Max resident frames, 0 for none. */
+    size_t ws_estimate;                 /* Pages accessed in last full pass. */
+    size_t ws_seen, ws_refs;            /* Progress of current pass. */
+
+    /* Fault-around and stack growth state, owned by vm/page.c. */
+    void *fault_next;                   /* Where a sequential fault lands. */
+    size_t fault_window;                /* Neighbours to map per fault. */
+    void *stack_bottom;                 /* Lowest stack page grown. */
+    size_t stack_window;                /* Stack pages to grow per fault. */
+    size_t stack_reserve;               /* Stack pages reserved at exec,
+                                           0 for the kernel default. */
     struct file *bin_file;              /* The binary executable. */
 
     /* Owned by syscall.c */
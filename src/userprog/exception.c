@@ -7,6 +7,7 @@
 #include "threads/vaddr.h"
 #include "userprog/syscall.h"
 #include "vm/page.h"
+#include "vm/vmstat.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -111,9 +112,10 @@ kill (struct intr_frame *f)
     }
 }
 
-/* Page fault handler.  This is a skeleton that must be filled in
-   to implement virtual memory.  Some solutions to project 2 may
-   also require modifying this code.
+/* Page fault handler.  Brings in pages of the faulting process
+   that are not present, growing its stack when the access is
+   close enough to the stack pointer, and kills the process
+   otherwise.
 
    At entry, the address that faulted is in CR2 (Control Register
    2) and information about the fault, formatted as described in
@@ -129,6 +131,7 @@ page_fault (struct intr_frame *f)
   bool write;        /* True: access was write, false: access was read. */
   bool user;         /* True: access by user, false: access by kernel. */
   void *fault_addr;  /* Fault address. */
+  uint64_t start;    /* Timestamp counter at entry. */
 
   /* Obtain faulting address, the virtual address that was
      accessed to cause the fault.  It may point to code or to
@@ -138,6 +141,7 @@ page_fault (struct intr_frame *f)
      [IA32-v3a] 5.15 "Interrupt 14--Page Fault Exception
      (#PF)". */
   asm ("movl %%cr2, %0" : "=r" (fault_addr));
+  start = vmstat_fault_begin ();
 
   /* Turn interrupts back on (they were only off so that we could
      be assured of reading CR2 before it changed). */
@@ -145,12 +149,37 @@ page_fault (struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+  vm_stats.faults++;
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+  /* Bring in the page, if the process has one there, or give it a
+     private frame on a write to the shared zero frame.  Kernel code
+     faults here too, when a system call touches a user page that
+     has been evicted; the user stack pointer saved at system call
+     entry then stands in for f->esp. */
+  if ((not_present || write) && fault_addr >= (void *) LOWEST_USER_VADDR
+      && is_user_vaddr (fault_addr))
+    {
+      void *esp = user ? f->esp : thread_current ()->user_esp;
+
+      if (page_in (fault_addr, write, start))
+        return;
+      if (not_present && fault_addr >= esp - 32
+          && stack_grow (fault_addr, write))
+        {
+          vmstat_fault_end (FAULT_STACK, start);
+          return;
+        }
+    }
+
+  vm_stats.invalid_faults++;
+
+  /* A bad user address dereferenced by get_user(): resume at the
+     address it left in EAX and report failure. */
   if (!user)
   {
     f->eip = (void (*) (void))f->eax;
@@ -158,25 +187,7 @@ page_fault (struct intr_frame *f)
     return;
   }
 
-  /* TODO: Finish the "paging in" routine.
-  bool is_page_loaded = false;
-  if (not_present && fault_addr > LOWEST_USER_VADDR && is_user_vaddr (fault_addr))
-  {
-    struct page *loaded_page;
-    if (loaded_page)
-    {
-
-    }
-    else
-    {
-      if (fault_addr >= f->esp - 32)
-    } 
-  }
-  */
-
-  /* To implement virtual memory, delete the rest of the function
-   body, and replace it with code that brings in the page to
-   which fault_addr refers. */
+  /* A genuine fault in user code: kill the process. */
   printf ("Page fault at %p: %s error %s page in %s context.\n",
         fault_addr,
         not_present ? "not present" : "rights violation",
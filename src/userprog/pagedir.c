@@ -5,9 +5,10 @@
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/thread.h"
 
 static uint32_t *active_pd (void);
-static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -152,7 +153,7 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
     }
 }
 
@@ -180,11 +181,27 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
 
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD.  Other bits in the page table entry are preserved. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL) 
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else 
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_page (pd, vpage);
+    }
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD has been
    accessed recently, that is, between the time the PTE was
    installed and the last time it was cleared.  Returns false if
@@ -209,7 +226,7 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -243,21 +260,71 @@ active_pd (void)
   return ptov (pd);
 }
 
-/* Seom page table changes can cause the CPU's translation
+/* Deferred TLB invalidations of the thread running a batch (see
+   pagedir_batch_begin()).  Only one thread batches at a time. */
+#define BATCH_MAX 32
+static struct thread *batch_owner;      /* Batching thread, if any. */
+static const void *batch_pages[BATCH_MAX]; /* Pages to invalidate. */
+static size_t batch_cnt;                /* Entries in batch_pages. */
+static bool batch_overflow;             /* Too many: flush everything. */
+
+/* Some page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
-   table.  When this happens, we have to "invalidate" the TLB by
-   re-activating it.
+   table.  When this happens, we have to "invalidate" the TLB
+   entry for the changed page.
 
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   This function invalidates VPAGE's TLB entry with INVLPG if PD
+   is the active page directory, leaving the rest of the TLB
+   alone.  (If PD is not active then its entries are not in the
+   TLB, so there is no need to invalidate anything.)  Inside a
+   batch, the invalidation is deferred to pagedir_batch_end(). */
 static void
-invalidate_pagedir (uint32_t *pd) 
+invalidate_page (uint32_t *pd, const void *vpage) 
 {
-  if (active_pd () == pd) 
+  if (active_pd () != pd) 
+    return;
+
+  if (batch_owner == thread_current ())
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
-    } 
+      if (batch_cnt < BATCH_MAX)
+        batch_pages[batch_cnt++] = vpage;
+      else
+        batch_overflow = true;
+    }
+  else
+    asm volatile ("invlpg (%0)" : : "r" (vpage) : "memory");
+}
+
+/* Starts deferring the running thread's TLB invalidations until
+   pagedir_batch_end(), so that a sweep clearing many accessed
+   bits pays for at most one flush.  Only for changes that may
+   take effect late: a stale TLB entry keeps the old bits until
+   the batch ends.  Callers must keep batches from overlapping. */
+void
+pagedir_batch_begin (void) 
+{
+  ASSERT (batch_owner == NULL);
+
+  batch_owner = thread_current ();
+  batch_cnt = 0;
+  batch_overflow = false;
+}
+
+/* Carries out the invalidations deferred since
+   pagedir_batch_begin(): one INVLPG per page, or a single reload
+   of CR3 if there were too many to track.  Kernel mappings are
+   global, so even the reload leaves them in the TLB. */
+void
+pagedir_batch_end (void) 
+{
+  size_t i;
+
+  ASSERT (batch_owner == thread_current ());
+
+  batch_owner = NULL;
+  if (batch_overflow)
+    pagedir_activate (active_pd ());
+  else
+    for (i = 0; i < batch_cnt; i++)
+      asm volatile ("invlpg (%0)" : : "r" (batch_pages[i]) : "memory");
 }
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -18,11 +19,13 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "vm/page.h"
 
 #define MAX_FILE_NAME_LENGTH 100
 #define MAX_ARGS 30
 
 static thread_func start_process NO_RETURN;
+static thread_func fork_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 static int deferred_down (char *, int);
 static void deferred_up (char *, int, int);
@@ -155,8 +158,11 @@ process_execute (const char *file_name)
   struct thread *t = get_thread (tid);
   t->fd_count = 2;
   t->program_name = cmd_name;
+  t->rss_limit = thread_current ()->rss_limit;
+  t->stack_reserve = thread_current ()->stack_reserve;
   list_init(&t->fd_list);
   list_init(&t->child_list);
+  list_init(&t->mappings);
   
   int return_tid = deferred_down("exec", tid);
   if (return_tid != -1)
@@ -206,6 +212,154 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+/* What a child created by process_fork() needs from its parent. */
+struct fork_info
+{
+  struct thread *parent;        /* Forking process, blocked meanwhile. */
+  struct intr_frame if_;        /* Parent's user registers. */
+  char *program_name;           /* Copy of the parent's program name. */
+};
+
+/* Creates a child process that is a copy of the running one,
+   resuming in user mode from the registers in PARENT_IF.  Returns
+   the child's thread id, or -1 if it could not be created.  The
+   child's address space shares the parent's frames copy-on-write,
+   so this costs time proportional to the page table, not to the
+   image. */
+tid_t
+process_fork (const struct intr_frame *parent_if)
+{
+  struct thread *cur = thread_current ();
+  struct fork_info *info;
+  tid_t tid;
+
+  info = malloc (sizeof *info);
+  if (info == NULL)
+    return -1;
+  info->parent = cur;
+  info->if_ = *parent_if;
+  info->program_name = malloc (strlen (cur->program_name) + 1);
+  if (info->program_name == NULL)
+    {
+      free (info);
+      return -1;
+    }
+  strlcpy (info->program_name, cur->program_name,
+           strlen (cur->program_name) + 1);
+
+  tid = thread_create (cur->name, PRI_DEFAULT, fork_process, info);
+  if (tid == TID_ERROR)
+    {
+      free (info->program_name);
+      free (info);
+      return -1;
+    }
+
+  int return_tid = deferred_down ("fork", tid);
+  if (return_tid != -1)
+  {
+    struct process_id *p = malloc (sizeof (struct process_id));
+    p->pid = return_tid;
+    list_push_back (&cur->child_list, &p->elem);
+  }
+
+  return return_tid;
+}
+
+/* Gives the running thread copies of PARENT's open files, at the
+   same descriptors and positions.  Returns true if successful. */
+static bool
+fork_files (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  t->fd_count = parent->fd_count;
+  for (e = list_begin (&parent->fd_list); e != list_end (&parent->fd_list);
+       e = list_next (e))
+    {
+      struct fd_elem *pfd = list_entry (e, struct fd_elem, elem);
+      struct fd_elem *cfd = malloc (sizeof *cfd);
+      if (cfd == NULL)
+        return false;
+      cfd->fd = pfd->fd;
+      cfd->file = file_reopen (pfd->file);
+      if (cfd->file == NULL)
+        {
+          free (cfd);
+          return false;
+        }
+      file_seek (cfd->file, file_tell (pfd->file));
+      list_push_back (&t->fd_list, &cfd->elem);
+    }
+  return true;
+}
+
+/* Gives the running thread a copy-on-write copy of PARENT's
+   address space.  Returns true if successful. */
+static bool
+fork_address_space (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    return false;
+  process_activate ();
+
+  t->pages = page_table_create ();
+  if (t->pages == NULL)
+    return false;
+  list_init (&t->frames);
+  t->fault_next = NULL;
+  t->fault_window = 0;
+  t->stack_bottom = NULL;
+  t->stack_window = 0;
+
+  t->executable = file_reopen (parent->executable);
+  if (t->executable == NULL)
+    return false;
+  file_deny_write (t->executable);
+
+  return page_table_fork (parent, t->executable);
+}
+
+/* A thread function that turns a new thread into a copy of the
+   process that called process_fork() and starts it running, with
+   fork() returning 0. */
+static void
+fork_process (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *t = thread_current ();
+  struct thread *parent = info->parent;
+  struct intr_frame if_ = info->if_;
+  bool success;
+
+  t->program_name = info->program_name;
+  t->rss_limit = parent->rss_limit;
+  t->stack_reserve = parent->stack_reserve;
+  list_init (&t->fd_list);
+  list_init (&t->child_list);
+  list_init (&t->mappings);
+  free (info);
+
+  success = fork_address_space (parent) && fork_files (parent);
+  if (!success)
+  {
+    deferred_up ("fork", thread_tid (), -1);
+    thread_exit (-1);
+  }
+
+  deferred_up ("fork", thread_tid (), thread_tid ());
+
+  /* Return to user mode as the parent did, but with fork()
+     returning 0. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -271,6 +425,15 @@ process_exit (int status)
     }
   }
 
+  /* Release the process's pages while its page directory and
+     executable are still around, writing back its mapped files. */
+  if (cur->pages != NULL)
+    {
+      syscall_exit ();
+      page_table_destroy (cur->pages);
+      cur->pages = NULL;
+    }
+
   file_close(thread_current()->executable);
   printf("%s: exit(%d)\n", cur->program_name, status);
 
@@ -411,6 +574,16 @@ load (const char *file_name, void (**eip) (void), void **esp)
     goto done;
   process_activate ();
 
+  /* Create supplemental page table. */
+  t->pages = page_table_create ();
+  if (t->pages == NULL)
+    goto done;
+  list_init (&t->frames);
+  t->fault_next = NULL;
+  t->fault_window = 0;
+  t->stack_bottom = NULL;
+  t->stack_window = 0;
+
   /* Open executable file. */
   file = filesys_open (argv[0]);
   if (file == NULL) 
@@ -517,8 +690,6 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
-static bool install_page (void *upage, void *kpage, bool writable);
-
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
 static bool
@@ -576,8 +747,11 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   Nothing is read here: each page only records where its contents
+   come from, and page_fault() brings it in on first touch.
+
    Return true if successful, false if a memory allocation error
-   or disk read error occurs. */
+   occurs. */
 static bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage,
               uint32_t read_bytes, uint32_t zero_bytes, bool writable) 
@@ -586,7 +760,6 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
       /* Calculate how to fill this page.
@@ -595,29 +768,22 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-      /* Get a page of memory. */
-      uint8_t *kpage = palloc_get_page (PAL_USER);
-      if (kpage == NULL)
+      /* Add a page to the process's address space.  A page with
+         nothing to read is left to fault in from the zero frame. */
+      struct page *p = page_allocate (upage, !writable);
+      if (p == NULL)
         return false;
-
-      /* Load this page. */
-      if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
+      if (page_read_bytes > 0)
         {
-          palloc_free_page (kpage);
-          return false; 
-        }
-      memset (kpage + page_read_bytes, 0, page_zero_bytes);
-
-      /* Add the page to the process's address space. */
-      if (!install_page (upage, kpage, writable)) 
-        {
-          palloc_free_page (kpage);
-          return false; 
+          p->file = file;
+          p->file_offset = ofs;
+          p->file_bytes = page_read_bytes;
         }
 
       /* Advance. */
       read_bytes -= page_read_bytes;
       zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
       upage += PGSIZE;
     }
   return true;
@@ -628,13 +794,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp, char **argv, int argc) 
 {
-  uint8_t *kpage;
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
   bool success = false;
 
-  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-  if (kpage != NULL) 
+  if (page_allocate (upage, false) != NULL) 
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
+      /* Keep the frame locked while the arguments are pushed. */
+      success = page_lock (upage, true);
       if (success)
       {
         *esp = PHYS_BASE;
@@ -675,35 +841,14 @@ setup_stack (void **esp, char **argv, int argc)
 
         *esp = *esp - 4;
         (*(int *)(*esp)) = 0;
-      }
-      else
-      {
-        palloc_free_page (kpage);
+
+        page_unlock (upage);
+        success = page_reserve_stack ();
       }
     }
   return success;
 }
 
-/* Adds a mapping from user virtual address UPAGE to kernel
-   virtual address KPAGE to the page table.
-   If WRITABLE is true, the user process may modify the page;
-   otherwise, it is read-only.
-   UPAGE must not already be mapped.
-   KPAGE should probably be a page obtained from the user pool
-   with palloc_get_page().
-   Returns true on success, false if UPAGE is already mapped or
-   if memory allocation fails. */
-static bool
-install_page (void *upage, void *kpage, bool writable)
-{
-  struct thread *t = thread_current ();
-
-  /* Verify that there's not already a page at that virtual
-     address, then map our page there. */
-  return (pagedir_get_page (t->pagedir, upage) == NULL
-          && pagedir_set_page (t->pagedir, upage, kpage, writable));
-}
-
 // Check current thread's list of open files for fd
 struct fd_elem* find_fd (int fd)
 {
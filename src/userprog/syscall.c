@@ -12,6 +12,9 @@
 #include "threads/palloc.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "vm/frame.h"
+#include "vm/vmstat.h"
+#include <round.h>
 #include <string.h>
 
 static void syscall_handler (struct intr_frame *);
@@ -44,6 +47,14 @@ unsigned tell(int fd);
 void close(int fd);
 void munmap (mapid_t mapping);
 mapid_t mmap (int fd, void *addr);
+mapid_t mmap_range (int fd, void *addr, unsigned offset, unsigned length,
+                    int flags);
+bool msync (void *addr, unsigned length);
+bool setrss (unsigned max_pages);
+bool vmstat (struct vmstat *stats);
+bool setstack (unsigned pages);
+bool madvise (void *addr, unsigned length, int advice);
+bool faultstat (struct faultstat *stats);
 
 /* Since the return value of the call doesn't necessarily indicate success in executing the system call (i.e. wait), 
    we desynchronize the value stored in the frame pointer's EAX from the success of the call. */
@@ -61,6 +72,14 @@ static int tell_wrapper(struct intr_frame *f);
 static int close_wrapper(struct intr_frame *f);
 static int munmap_wrapper(struct intr_frame *f);
 static int mmap_wrapper(struct intr_frame *f);
+static int setrss_wrapper(struct intr_frame *f);
+static int vmstat_wrapper(struct intr_frame *f);
+static int fork_wrapper(struct intr_frame *f);
+static int setstack_wrapper(struct intr_frame *f);
+static int madvise_wrapper(struct intr_frame *f);
+static int mmap_range_wrapper(struct intr_frame *f);
+static int msync_wrapper(struct intr_frame *f);
+static int faultstat_wrapper(struct intr_frame *f);
 
 static struct lock file_lock;
 
@@ -99,11 +118,25 @@ is_valid_string (void * str)
       return false;
 }
 
+/* Returns true if the SIZE bytes at UADDR lie entirely in user
+   memory, between LOWEST_USER_VADDR and PHYS_BASE. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  return (const uint8_t *) uaddr >= (const uint8_t *) LOWEST_USER_VADDR
+         && size <= (size_t) ((const uint8_t *) PHYS_BASE
+                              - (const uint8_t *) uaddr);
+}
+
 static void
 syscall_handler (struct intr_frame *f) 
 {
   int syscall_return_value = -1;
 
+  /* Remember the user stack pointer, in case a page fault in the
+     kernel has to grow the user stack. */
+  thread_current ()->user_esp = f->esp;
+
   // Verify that the user provided virtual address is valid
   if (verify_user_ptr (f->esp, 4)) 
   {
@@ -199,6 +232,52 @@ syscall_handler (struct intr_frame *f)
         {
           syscall_return_value = munmap_wrapper(f);
         }
+        break;
+      case SYS_SETRSS:
+        if (verify_user_ptr ((f->esp + 4), 4))
+        {
+          syscall_return_value = setrss_wrapper(f);
+        }
+        break;
+      case SYS_VMSTAT:
+        if (verify_user_ptr ((f->esp + 4), 4))
+        {
+          syscall_return_value = vmstat_wrapper(f);
+        }
+        break;
+      case SYS_FORK:
+        syscall_return_value = fork_wrapper(f);
+        break;
+      case SYS_SETSTACK:
+        if (verify_user_ptr ((f->esp + 4), 4))
+        {
+          syscall_return_value = setstack_wrapper(f);
+        }
+        break;
+      case SYS_MADVISE:
+        if (verify_user_ptr ((f->esp + 4), 4) && verify_user_ptr ((f->esp + 8), 4) && verify_user_ptr ((f->esp + 12), 4))
+        {
+          syscall_return_value = madvise_wrapper(f);
+        }
+        break;
+      case SYS_MMAP_RANGE:
+        if (verify_user_ptr ((f->esp + 4), 4) && verify_user_ptr ((f->esp + 8), 4) && verify_user_ptr ((f->esp + 12), 4)
+            && verify_user_ptr ((f->esp + 16), 4) && verify_user_ptr ((f->esp + 20), 4))
+        {
+          syscall_return_value = mmap_range_wrapper(f);
+        }
+        break;
+      case SYS_MSYNC:
+        if (verify_user_ptr ((f->esp + 4), 4) && verify_user_ptr ((f->esp + 8), 4))
+        {
+          syscall_return_value = msync_wrapper(f);
+        }
+        break;
+      case SYS_FAULTSTAT:
+        if (verify_user_ptr ((f->esp + 4), 4))
+        {
+          syscall_return_value = faultstat_wrapper(f);
+        }
         break;
 		  default:
 			 break;
@@ -385,18 +464,49 @@ read_wrapper(struct intr_frame *f)
   return 0;
 }
 
+/* Returns the number of bytes from user address UADDR, at most
+   SIZE, that lie in the same page: the most read() and write() pin
+   at once, so that a large transfer holds only one frame locked
+   however big its buffer. */
+static unsigned
+chunk_size (const void *uaddr, unsigned size)
+{
+  unsigned left = PGSIZE - pg_ofs (uaddr);
+  return size < left ? size : left;
+}
+
+/* Reads into BUFFER a page at a time, with each page pinned, so that
+   no page fault, and so no eviction or swap I/O, can happen under
+   file_lock.  Kills the process if BUFFER is not writable user
+   memory. */
 int 
 read (int fd, void *buffer, unsigned size) 
 {
-  if (find_fd(fd) != NULL)
-  {
-    struct fd_elem *fd_elem = find_fd(fd);
-    lock_acquire(&file_lock);
-    int fr = file_read(fd_elem->file, buffer, size);
-    lock_release(&file_lock);
-    return fr;
-  }
-  return -1;
+  struct fd_elem *fd_elem = find_fd (fd);
+  uint8_t *udst = buffer;
+  int fr = 0;
+
+  if (fd_elem == NULL)
+    return -1;
+  while (size > 0)
+    {
+      unsigned chunk = chunk_size (udst, size);
+      off_t n;
+
+      if (!page_pin_range (udst, chunk, true))
+        exit (-1);
+      lock_acquire (&file_lock);
+      n = file_read (fd_elem->file, udst, chunk);
+      lock_release (&file_lock);
+      page_unpin_range (udst, chunk);
+
+      fr += n;
+      if ((unsigned) n < chunk)
+        break;
+      udst += n;
+      size -= n;
+    }
+  return fr;
 }
 
 static int
@@ -413,24 +523,45 @@ write_wrapper(struct intr_frame *f)
   return 0;
 }
 
+/* Writes from BUFFER a page at a time, with each page pinned, as
+   in read(). */
 int 
 write (int fd, const void *buffer, unsigned size)
 {
-  // Write to console
-  if (fd == STDOUT_FILENO)
-  {
-    putbuf((char *)buffer, (size_t)size);
-    return (int)size;
-  }
-  else if (find_fd(fd) != NULL)
-  {
-    lock_acquire(&file_lock);
-    int fw = (int)file_write(find_fd(fd)->file, buffer, size);
-    lock_release(&file_lock);
-    return fw;
-  }
+  struct fd_elem *fd_elem = NULL;
+  const uint8_t *usrc = buffer;
+  int fw = 0;
 
-  return -1;
+  if (fd != STDOUT_FILENO && (fd_elem = find_fd (fd)) == NULL)
+    return -1;
+  while (size > 0)
+    {
+      unsigned chunk = chunk_size (usrc, size);
+      off_t n;
+
+      if (!page_pin_range (usrc, chunk, false))
+        exit (-1);
+      // Write to console
+      if (fd == STDOUT_FILENO)
+      {
+        putbuf ((const char *) usrc, chunk);
+        n = chunk;
+      }
+      else
+      {
+        lock_acquire (&file_lock);
+        n = file_write (fd_elem->file, usrc, chunk);
+        lock_release (&file_lock);
+      }
+      page_unpin_range (usrc, chunk);
+
+      fw += n;
+      if ((unsigned) n < chunk)
+        break;
+      usrc += n;
+      size -= n;
+    }
+  return fw;
 }
 
 static int
@@ -505,25 +636,329 @@ munmap_wrapper (struct intr_frame *f)
   return 0;
 }
 
+/* Returns the running process's mapping with id HANDLE, or a null
+   pointer if there is none. */
+static struct mapping *
+find_mapping (mapid_t handle)
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings); e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->handle == handle)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes the pages of mapping M, writing the dirty pages of a
+   shared mapping back to its file, then closes its file and frees
+   it. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_deallocate (m->base + i * PGSIZE);
+
+  list_remove (&m->elem);
+  lock_acquire (&file_lock);
+  file_close (m->file);
+  lock_release (&file_lock);
+  free (m);
+}
+
 void 
 munmap (mapid_t mapping)
 {
+  struct mapping *m = find_mapping (mapping);
+  if (m != NULL)
+    unmap (m);
+}
+
+/* Removes all of the running process's mappings, as munmap() does,
+   for process_exit(). */
+void
+syscall_exit (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_front (mappings), struct mapping, elem));
+}
+
+/* Returns true if UPAGE lies within one of thread T's memory
+   mappings.  T must not be running mmap() or munmap() meanwhile. */
+bool
+syscall_is_mapped (struct thread *t, const void *upage)
+{
+  struct list_elem *e;
 
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if ((const uint8_t *) upage >= m->base
+          && (const uint8_t *) upage < m->base + m->page_cnt * PGSIZE)
+        return true;
+    }
+  return false;
 }
 
 static int 
 mmap_wrapper (struct intr_frame *f)
 {
-  int return_value = 0;
-  return_value = mmap((*(int *)(f->esp + 4)), *(uint8_t **)(f->esp + 8));
-  f->eax = return_value;
-  return return_value;
+  f->eax = mmap((*(int *)(f->esp + 4)), *(uint8_t **)(f->esp + 8));
+  return 0;
 }
 
+/* Maps all of file FD at ADDR, shared. */
 mapid_t 
 mmap (int fd, void *addr)
 {
-  return -1;
+  struct fd_elem *fde = find_fd (fd);
+  off_t length;
+
+  if (fde == NULL)
+    return MAP_FAILED;
+  lock_acquire (&file_lock);
+  length = file_length (fde->file);
+  lock_release (&file_lock);
+  return mmap_range (fd, addr, 0, length, MAP_SHARED);
+}
+
+static int
+mmap_range_wrapper (struct intr_frame *f)
+{
+  int fd_from_frame = *(int *)(f->esp + 4);
+  void *addr_from_frame = *(void **)(f->esp + 8);
+  unsigned offset_from_frame = *(unsigned *)(f->esp + 12);
+  unsigned length_from_frame = *(unsigned *)(f->esp + 16);
+  int flags_from_frame = *(int *)(f->esp + 20);
+
+  f->eax = mmap_range (fd_from_frame, addr_from_frame, offset_from_frame,
+                       length_from_frame, flags_from_frame);
+  return 0;
+}
+
+/* Maps the LENGTH bytes of file FD starting at OFFSET, which must be
+   page-aligned and inside the file, at page-aligned user address
+   ADDR.  Pages are read in on first access.  With MAP_SHARED in
+   FLAGS, changes go back to the file when pages are evicted, synced
+   with msync() or unmapped; with MAP_PRIVATE they go to swap and are
+   lost at munmap().  Bytes of the last page past LENGTH or the end of
+   the file read as zeros and are never written back.  Fails if the
+   range overlaps any page the process already has. */
+mapid_t
+mmap_range (int fd, void *addr, unsigned offset, unsigned length, int flags)
+{
+  struct thread *t = thread_current ();
+  struct fd_elem *fde = find_fd (fd);
+  struct mapping *m;
+  off_t file_len;
+  size_t i;
+
+  if (fde == NULL || addr == NULL || pg_ofs (addr) != 0
+      || (uint8_t *) addr < (uint8_t *) LOWEST_USER_VADDR
+      || offset % PGSIZE != 0 || length == 0
+      || length > (size_t) ((uint8_t *) PHYS_BASE - (uint8_t *) addr)
+      || (flags != MAP_SHARED && flags != MAP_PRIVATE))
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  lock_acquire (&file_lock);
+  m->file = file_reopen (fde->file);
+  file_len = m->file != NULL ? file_length (m->file) : 0;
+  lock_release (&file_lock);
+  if (m->file == NULL || offset >= (unsigned) file_len)
+    {
+      lock_acquire (&file_lock);
+      file_close (m->file);
+      lock_release (&file_lock);
+      free (m);
+      return MAP_FAILED;
+    }
+
+  m->handle = t->next_handle++;
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  list_push_back (&t->mappings, &m->elem);
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      struct page *p = find_page (m->base + i * PGSIZE) == NULL
+                       ? page_allocate (m->base + i * PGSIZE, false) : NULL;
+      off_t ofs = offset + i * PGSIZE;
+      off_t bytes = length - i * PGSIZE;
+
+      if (p == NULL)
+        {
+          /* Leave the pages that were there before alone. */
+          m->page_cnt = i;
+          unmap (m);
+          return MAP_FAILED;
+        }
+      if (bytes > PGSIZE)
+        bytes = PGSIZE;
+      if (bytes > file_len - ofs)
+        bytes = ofs < file_len ? file_len - ofs : 0;
+
+      p->private = flags == MAP_PRIVATE;
+      p->file = m->file;
+      p->file_offset = ofs;
+      p->file_bytes = bytes;
+    }
+  return m->handle;
+}
+
+static int
+msync_wrapper (struct intr_frame *f)
+{
+  void *addr_from_frame = *(void **)(f->esp + 4);
+  unsigned length_from_frame = *(unsigned *)(f->esp + 8);
+
+  f->eax = msync (addr_from_frame, length_from_frame);
+  return 0;
+}
+
+/* Writes the dirty pages of shared file mappings in the LENGTH bytes
+   at ADDR back to their files without unmapping them.  Fails if the
+   range is not in user memory or a write fails. */
+bool
+msync (void *addr, unsigned length)
+{
+  if ((uint8_t *) addr < (uint8_t *) LOWEST_USER_VADDR
+      || length > (size_t) ((uint8_t *) PHYS_BASE - (uint8_t *) addr))
+    return false;
+  return page_sync (addr, length);
+}
+
+static int
+setrss_wrapper (struct intr_frame *f)
+{
+  f->eax = setrss (*(unsigned *)(f->esp + 4));
+  return 0;
+}
+
+/* Limits the calling process to MAX_PAGES resident pages, or lifts
+   the limit if MAX_PAGES is 0.  Processes it executes afterward
+   start out with the same limit.  Fails for a limit below
+   RSS_LIMIT_MIN, which would leave the process too few frames to
+   make progress. */
+bool
+setrss (unsigned max_pages)
+{
+  if (max_pages != 0 && max_pages < RSS_LIMIT_MIN)
+    return false;
+  frame_set_rss_limit (thread_current (), max_pages);
+  return true;
+}
+
+static int
+vmstat_wrapper (struct intr_frame *f)
+{
+  f->eax = vmstat (*(struct vmstat **)(f->esp + 4));
+  return 0;
+}
+
+/* Copies the kernel's virtual memory statistics into *STATS.  The
+   buffer is locked into memory writable with page_pin_range() for
+   the copy, so that it cannot fault or be evicted meanwhile.  Kills
+   the process if STATS is not writable user memory. */
+bool
+vmstat (struct vmstat *stats)
+{
+  struct vmstat snapshot;
+
+  if (!is_user_range (stats, sizeof *stats)
+      || !page_pin_range (stats, sizeof *stats, true))
+    exit (-1);
+  vmstat_snapshot (&snapshot);
+  memcpy (stats, &snapshot, sizeof snapshot);
+  page_unpin_range (stats, sizeof *stats);
+  return true;
+}
+
+/* fork() needs the caller's registers, so there is no separate
+   kernel function for it: the child is built by process_fork(). */
+static int
+fork_wrapper (struct intr_frame *f)
+{
+  f->eax = process_fork (f);
+  return 0;
+}
+
+static int
+setstack_wrapper (struct intr_frame *f)
+{
+  f->eax = setstack (*(unsigned *)(f->esp + 4));
+  return 0;
+}
+
+/* Reserves PAGES of stack, or the kernel default if PAGES is 0, for
+   the programs the calling process executes afterward.  Fails if
+   that much stack would exceed STACK_LIMIT. */
+bool
+setstack (unsigned pages)
+{
+  if (pages > STACK_LIMIT / PGSIZE)
+    return false;
+  thread_current ()->stack_reserve = pages;
+  return true;
+}
+
+static int
+madvise_wrapper (struct intr_frame *f)
+{
+  void *addr_from_frame = *(void **)(f->esp + 4);
+  unsigned length_from_frame = *(unsigned *)(f->esp + 8);
+  int advice_from_frame = *(int *)(f->esp + 12);
+
+  f->eax = madvise (addr_from_frame, length_from_frame, advice_from_frame);
+  return 0;
+}
+
+/* Applies ADVICE, one of the MADV_* hints, to the calling
+   process's pages in the LENGTH bytes at ADDR.  Pages in the range
+   that the process does not have are ignored.  Fails if the range
+   is not in user memory or ADVICE is unknown. */
+bool
+madvise (void *addr, unsigned length, int advice)
+{
+  if ((uint8_t *) addr < (uint8_t *) LOWEST_USER_VADDR
+      || length > (size_t) ((uint8_t *) PHYS_BASE - (uint8_t *) addr))
+    return false;
+  return page_advise (addr, length, advice);
+}
+
+static int
+faultstat_wrapper (struct intr_frame *f)
+{
+  f->eax = faultstat (*(struct faultstat **)(f->esp + 4));
+  return 0;
+}
+
+/* Copies the kernel's page fault latency histograms into *STATS.
+   As in vmstat(), the buffer is locked into memory writable with
+   page_pin_range() for the copy.  Kills the process if STATS is not
+   writable user memory. */
+bool
+faultstat (struct faultstat *stats)
+{
+  struct faultstat snapshot;
+
+  if (!is_user_range (stats, sizeof *stats)
+      || !page_pin_range (stats, sizeof *stats, true))
+    exit (-1);
+  vmstat_fault_snapshot (&snapshot);
+  memcpy (stats, &snapshot, sizeof snapshot);
+  page_unpin_range (stats, sizeof *stats);
+  return true;
 }
 
 bool 
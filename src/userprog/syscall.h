@@ -12,6 +12,10 @@ to compare validty*/
 #define LOWEST_USER_VADDR 0x08048000
 
 void syscall_init (void);
+struct thread;
+
+void syscall_exit (void);
+bool syscall_is_mapped (struct thread *, const void *upage);
 bool get_args (struct intr_frame *f, int **args, int argc);
 
 #endif /* userprog/syscall.h */
@@ -1,44 +1,774 @@
 #include "vm/frame.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include "userprog/pagedir.h"
+#include "vm/merge.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+#include "threads/malloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
 
-#define MAX_FRAMES 10
+/* Maximum number of frames the clock hand examines per eviction
+   attempt, so that the cost of an eviction does not grow with the
+   size of the user pool. */
+#define CLOCK_SCAN_MAX 64
 
-struct frame frames[MAX_FRAMES];
+/* Number of eviction attempts before frame_alloc() gives up. */
+#define EVICT_TRIES 3
+
+/* Number of frames ahead of the clock hand that the page cleaner
+   launders per round, and how long it sleeps between rounds. */
+#define CLEAN_AHEAD 32
+#define CLEAN_INTERVAL_MS 50
+
+/* Frame table, with one entry per page in the user pool.  The
+   frame for user kernel virtual page KPAGE is always
+   frames[(KPAGE - frame_base) / PGSIZE]. */
+static struct frame *frames;
 
 static struct lock scan_lock; /* lock to protect frames traversal */
 
-unsigned frame_ct; /* number of physical frames represented */
+static size_t frame_ct; /* number of physical frames represented */
+
+static uint8_t *frame_base; /* kernel virtual address of frames[0] */
+
+static size_t hand; /* clock hand for page eviction algorithm */
+
+static const struct evict_policy *policy; /* selected by -vm-policy */
+
+static struct list fifo_queue; /* frames in allocation order (fifo) */
+
+static unsigned evict_ct; /* evictions, read by the page cleaner */
 
-unsigned hand; /* clock hand for page eviction algorithm */
+/* Free frame reserve.  When frame_alloc() leaves fewer than low_wm
+   frames free, the reclaim thread is woken to evict pages until
+   high_wm frames are free again.  Protected by scan_lock. */
+static size_t low_wm, high_wm; /* watermarks, in frames */
+static size_t free_ct; /* frames currently free in the user pool */
+static bool reclaim_running; /* reclaim thread awake or about to be? */
+static struct semaphore reclaim_sema; /* wakes the reclaim thread */
+
+/* Allocation statistics. */
+static long long alloc_ct; /* frames handed out by frame_alloc() */
+static long long sync_evict_ct; /* allocations that had to evict */
+static long long reclaim_evict_ct; /* pages evicted by the reclaim thread */
+static long long rss_evict_ct; /* pages evicted by their own process */
+
+static void page_cleaner (void *aux);
+static void frame_reclaim (void *aux);
 
 
 /* Frame management function definitions */
 
-void frame_init (void)
+/* Sizes the frame table to the user pool set up by palloc_init()
+   and initializes every entry, then starts the page cleaner and
+   reclaim threads.  LOW and HIGH are the free frame watermarks, or
+   SIZE_MAX to choose them from the pool size.  Must be called after
+   thread_start(). */
+void frame_init (size_t low, size_t high)
 {
+	size_t i;
+
 	lock_init (&scan_lock);
+	list_init (&fifo_queue);
+	if (policy == NULL)
+		frame_set_policy ("clock");
+
+	frame_base = palloc_user_base ();
+	frame_ct = palloc_user_page_cnt ();
+	hand = 0;
+
+	frames = malloc (sizeof *frames * frame_ct);
+	if (frames == NULL && frame_ct > 0)
+		PANIC ("out of memory allocating frame table");
+
+	for (i = 0; i < frame_ct; i++)
+	{
+		struct frame *f = &frames[i];
+		lock_init (&f->lock);
+		f->base = frame_base + i * PGSIZE;
+		f->page = NULL;
+		f->age = 0;
+		f->hot = false;
+		f->shared = false;
+		f->merge_listed = false;
+		f->merge_sum = 0;
+	}
+	free_ct = frame_ct;
+
+	/* By default keep about 1/64 of the pool free, but no more
+	   than half of it. */
+	low_wm = low != SIZE_MAX ? low : frame_ct / 64 + 2;
+	high_wm = high != SIZE_MAX ? high : 2 * low_wm;
+	if (high_wm > frame_ct / 2)
+		high_wm = frame_ct / 2;
+	if (low_wm > high_wm)
+		low_wm = high_wm;
+	sema_init (&reclaim_sema, 0);
+	reclaim_running = false;
+
+	thread_create ("pagecleaner", PRI_MIN, page_cleaner, NULL);
+	thread_create ("pagereclaim", PRI_DEFAULT, frame_reclaim, NULL);
+}
+
+/* Returns the frame table entry for user kernel virtual page KPAGE. */
+struct frame *
+frame_for_kpage (const void *kpage)
+{
+	size_t idx = ((const uint8_t *) kpage - frame_base) / PGSIZE;
+
+	ASSERT (pg_ofs (kpage) == 0);
+	ASSERT ((const uint8_t *) kpage >= frame_base && idx < frame_ct);
+
+	return &frames[idx];
+}
+
+/* A page replacement policy.  All hooks run with scan_lock held.
+   INSTALL and REMOVE, which may be null, are told when a frame
+   gains or loses a page, with the frame's lock held; REMOVE also
+   learns whether the page was evicted to make room, rather than
+   freed or unmapped by its process.  A frame handed from one sharer
+   to the next keeps its place and is not reported.  PICK_VICTIM
+   returns a frame that holds a page, locked by the caller, or a
+   null pointer if every frame it examined was busy. */
+struct evict_policy
+{
+	const char *name;                       /* Name for -vm-policy. */
+	void (*install) (struct frame *);       /* Frame got a page. */
+	void (*remove) (struct frame *, bool evicted); /* Frame lost its page. */
+	struct frame *(*pick_victim) (void);    /* Chooses a victim. */
+};
+
+/* Advances the clock hand and returns the frame it passed over. */
+static struct frame *
+clock_advance (void)
+{
+	struct frame *f = &frames[hand];
+	if (++hand >= frame_ct)
+		hand = 0;
+	return f;
+}
+
+/* Advances the clock hand to the next frame that holds a page and
+   that can be locked without waiting, and returns it locked.
+   Frames whose lock is busy are being paged in or out and are
+   skipped.  Gives up and returns a null pointer once *BUDGET frames
+   have been passed over, decrementing *BUDGET as it goes. */
+static struct frame *
+clock_next_locked (size_t *budget)
+{
+	while (*budget > 0)
+	{
+		struct frame *f = clock_advance ();
+		(*budget)--;
+
+		if (lock_held_by_current_thread (&f->lock)
+		    || !lock_try_acquire (&f->lock))
+			continue;
+
+		/* Free, or on its way in or out of the user pool. */
+		if (f->page == NULL)
+		{
+			lock_release (&f->lock);
+			continue;
+		}
+
+		return f;
+	}
+	return NULL;
+}
+
+/* Returns the number of frames one sweep may examine. */
+static size_t
+scan_budget (void)
+{
+	return frame_ct < CLOCK_SCAN_MAX ? frame_ct : CLOCK_SCAN_MAX;
+}
+
+/* "clock": second chance.  Sweeps at most CLOCK_SCAN_MAX frames,
+   giving each recently accessed page a second chance by clearing
+   its accessed bit, and returns the first page that was not
+   recently accessed or, failing that, the first lockable frame
+   passed over. */
+static struct frame *
+clock_pick_victim (void)
+{
+	struct frame *fallback = NULL;
+	struct frame *f;
+	size_t budget = scan_budget ();
+
+	while ((f = clock_next_locked (&budget)) != NULL)
+	{
+		if (!page_accessed_recently (f->page))
+		{
+			if (fallback != NULL)
+				lock_release (&fallback->lock);
+			return f;
+		}
+
+		if (fallback == NULL)
+			fallback = f;
+		else
+			lock_release (&f->lock);
+	}
+
+	return fallback;
+}
+
+/* "lru-approx": aging.  Each frame keeps an 8-bit age that is
+   shifted right on every visit of the hand, with the accessed bit
+   shifted in at the top, so that the smallest age approximates the
+   least recently used page.  Returns the youngest-aged frame within
+   one bounded sweep. */
+static void
+lru_install (struct frame *f)
+{
+	f->age = 0x80;
+}
+
+static struct frame *
+lru_pick_victim (void)
+{
+	struct frame *victim = NULL;
+	struct frame *f;
+	size_t budget = scan_budget ();
+
+	while ((f = clock_next_locked (&budget)) != NULL)
+	{
+		f->age >>= 1;
+		if (page_accessed_recently (f->page))
+			f->age |= 0x80;
+
+		if (victim == NULL || f->age < victim->age)
+		{
+			if (victim != NULL)
+				lock_release (&victim->lock);
+			victim = f;
+			if (victim->age == 0)
+				break;
+		}
+		else
+			lock_release (&f->lock);
+	}
+
+	return victim;
+}
+
+/* "clock-pro": a simplified CLOCK-Pro.  Frames are hot or cold.
+   The hand demotes hot pages that were not accessed since its last
+   visit and evicts cold pages that were not accessed; a cold page
+   that was accessed is promoted.  Cold pages evicted are remembered
+   for a while, and one that faults back in during that test period
+   starts out hot.  Pages touched only once by a scan therefore never
+   displace the hot set.  Ghosts are keyed by process and address,
+   since page descriptors and threads are recycled but tids are not. */
+
+/* Number of recently evicted cold pages remembered. */
+#define GHOST_CNT 128
+
+/* A recently evicted cold page. */
+struct ghost
+{
+	tid_t tid;                  /* Owning process. */
+	const void *upage;          /* User virtual address, or null. */
+};
+
+static struct ghost ghosts[GHOST_CNT];  /* evicted cold pages */
+static size_t ghost_next;               /* next slot to overwrite */
+static size_t hot_cnt;                  /* number of hot frames */
+
+/* Maximum number of hot frames, leaving the rest for cold pages. */
+static size_t
+hot_max (void)
+{
+	return frame_ct - frame_ct / 4;
+}
+
+static void
+clock_pro_install (struct frame *f)
+{
+	size_t i;
+
+	f->hot = false;
+	for (i = 0; i < GHOST_CNT; i++)
+		if (ghosts[i].upage == f->page->addr
+		    && ghosts[i].tid == f->page->thread->tid)
+		{
+			ghosts[i].upage = NULL;
+			if (hot_cnt < hot_max ())
+			{
+				f->hot = true;
+				hot_cnt++;
+			}
+			break;
+		}
+}
+
+static void
+clock_pro_remove (struct frame *f, bool evicted)
+{
+	if (f->hot)
+	{
+		f->hot = false;
+		hot_cnt--;
+	}
+	else if (evicted)
+	{
+		ghosts[ghost_next].tid = f->page->thread->tid;
+		ghosts[ghost_next].upage = f->page->addr;
+		ghost_next = (ghost_next + 1) % GHOST_CNT;
+	}
+}
+
+static struct frame *
+clock_pro_pick_victim (void)
+{
+	struct frame *fallback = NULL;
+	struct frame *f;
+	size_t budget = scan_budget ();
+
+	while ((f = clock_next_locked (&budget)) != NULL)
+	{
+		bool accessed = page_accessed_recently (f->page);
+
+		if (!f->hot && !accessed)
+		{
+			if (fallback != NULL)
+				lock_release (&fallback->lock);
+			return f;
+		}
+
+		if (f->hot && !accessed)
+		{
+			f->hot = false;
+			hot_cnt--;
+		}
+		else if (!f->hot && accessed && hot_cnt < hot_max ())
+		{
+			f->hot = true;
+			hot_cnt++;
+		}
+
+		if (fallback == NULL || (fallback->hot && !f->hot))
+		{
+			if (fallback != NULL)
+				lock_release (&fallback->lock);
+			fallback = f;
+		}
+		else
+			lock_release (&f->lock);
+	}
+
+	return fallback;
+}
+
+/* "fifo": evicts the page that has been resident longest,
+   regardless of use.  Frames are queued in the order they received
+   their pages, in fifo_queue. */
+
+static void
+fifo_install (struct frame *f)
+{
+	list_push_back (&fifo_queue, &f->queue_elem);
+}
+
+static void
+fifo_remove (struct frame *f, bool evicted UNUSED)
+{
+	list_remove (&f->queue_elem);
+}
+
+static struct frame *
+fifo_pick_victim (void)
+{
+	struct list_elem *e;
+	size_t budget = scan_budget ();
+
+	for (e = list_begin (&fifo_queue);
+	     e != list_end (&fifo_queue) && budget > 0;
+	     e = list_next (e), budget--)
+	{
+		struct frame *f = list_entry (e, struct frame, queue_elem);
+
+		if (lock_held_by_current_thread (&f->lock)
+		    || !lock_try_acquire (&f->lock))
+			continue;
+		if (f->page != NULL)
+			return f;
+		lock_release (&f->lock);
+	}
+	return NULL;
+}
+
+/* Available page replacement policies.  The first is the default. */
+static const struct evict_policy policies[] =
+{
+	{"clock", NULL, NULL, clock_pick_victim},
+	{"lru-approx", lru_install, NULL, lru_pick_victim},
+	{"clock-pro", clock_pro_install, clock_pro_remove, clock_pro_pick_victim},
+	{"fifo", fifo_install, fifo_remove, fifo_pick_victim},
+	{NULL, NULL, NULL, NULL},
+};
+
+/* Selects the page replacement policy called NAME.  Returns false
+   if there is no such policy.  May be called before frame_init(). */
+bool
+frame_set_policy (const char *name)
+{
+	const struct evict_policy *p;
+
+	for (p = policies; p->name != NULL; p++)
+		if (!strcmp (p->name, name))
+		{
+			policy = p;
+			return true;
+		}
+	return false;
+}
+
+/* Adds F, which is locked and has just received a page, to its
+   owner's resident set and tells the replacement policy. */
+static void
+policy_install (struct frame *f)
+{
+	struct thread *owner = f->page->thread;
+
+	lock_acquire (&scan_lock);
+	list_push_back (&owner->frames, &f->owner_elem);
+	owner->resident_cnt++;
+	if (policy->install != NULL)
+		policy->install (f);
+	lock_release (&scan_lock);
+}
+
+/* Removes F, which is locked and is about to lose its page, from
+   its owner's resident set and tells the replacement policy, which
+   learns from EVICTED whether the page is being evicted. */
+static void
+policy_remove (struct frame *f, bool evicted)
+{
+	struct thread *owner = f->page->thread;
+
+	lock_acquire (&scan_lock);
+	list_remove (&f->owner_elem);
+	owner->resident_cnt--;
+	if (policy->remove != NULL)
+		policy->remove (f, evicted);
+	lock_release (&scan_lock);
+}
+
+/* Makes PAGE, which already shares frame F, the frame's first page
+   in place of the current one, moving F to PAGE's owner's resident
+   set.  The replacement policy's state for F is left alone, since F
+   keeps its contents.  F must be locked. */
+static void
+policy_hand_off (struct frame *f, struct page *page)
+{
+	lock_acquire (&scan_lock);
+	list_remove (&f->owner_elem);
+	f->page->thread->resident_cnt--;
+	f->page = page;
+	list_push_back (&page->thread->frames, &f->owner_elem);
+	page->thread->resident_cnt++;
+	lock_release (&scan_lock);
+}
+
+/* Returns true if thread T holds at least as many frames as its
+   resident set limit allows, so that it must page against itself. */
+static bool
+over_rss_limit (const struct thread *t)
+{
+	return t != NULL && t->rss_limit != 0 && t->resident_cnt >= t->rss_limit;
+}
+
+/* Chooses a victim among the resident frames of thread T, which is
+   at its resident set limit, by second chance over T's resident
+   list.  The same pass feeds T's working set estimate: after each
+   full turn through the list, ws_estimate is set to the number of
+   pages found accessed during it.  Returns the victim locked by the
+   caller, or a null pointer.  scan_lock must be held. */
+static struct frame *
+owner_pick_victim (struct thread *t)
+{
+	struct frame *fallback = NULL;
+	size_t budget = t->resident_cnt < CLOCK_SCAN_MAX ? t->resident_cnt : CLOCK_SCAN_MAX;
+
+	ASSERT (lock_held_by_current_thread (&scan_lock));
+
+	for (; budget > 0 && !list_empty (&t->frames); budget--)
+	{
+		struct frame *f = list_entry (list_pop_front (&t->frames),
+		                              struct frame, owner_elem);
+		bool accessed;
+
+		/* Rotate, so the next pass resumes after F. */
+		list_push_back (&t->frames, &f->owner_elem);
+
+		if (lock_held_by_current_thread (&f->lock)
+		    || !lock_try_acquire (&f->lock))
+			continue;
+
+		accessed = page_accessed_recently (f->page);
+		if (accessed)
+			t->ws_refs++;
+		if (++t->ws_seen >= t->resident_cnt)
+		{
+			t->ws_estimate = t->ws_refs;
+			t->ws_seen = t->ws_refs = 0;
+		}
+
+		if (!accessed)
+		{
+			if (fallback != NULL)
+				lock_release (&fallback->lock);
+			return f;
+		}
+
+		if (fallback == NULL)
+			fallback = f;
+		else
+			lock_release (&f->lock);
+	}
+
+	return fallback;
 }
 
-void* 
+/* Chooses a victim frame, evicts its page, and returns the frame
+   locked and unowned.  If OWNER is nonnull, the victim is one of
+   OWNER's own pages; otherwise the replacement policy chooses it
+   from the whole pool.  Returns a null pointer if no page could be
+   evicted. */
+static struct frame *
+frame_evict (struct thread *owner)
+{
+	int try;
+
+	for (try = 0; try < EVICT_TRIES; try++)
+	{
+		struct frame *f;
+
+		/* The sweep clears accessed bits as it goes; flush their
+		   TLB entries together at the end rather than one by one. */
+		lock_acquire (&scan_lock);
+		pagedir_batch_begin ();
+		f = owner != NULL ? owner_pick_victim (owner) : policy->pick_victim ();
+		pagedir_batch_end ();
+		lock_release (&scan_lock);
+
+		if (f == NULL)
+		{
+			/* A process's own busy frames are pinned by itself, so
+			   waiting will not free them; frame_alloc() falls back
+			   to the global pool instead. */
+			if (owner != NULL)
+				break;
+
+			/* Everything we looked at is busy; let the threads
+			   paging those frames finish. */
+			thread_yield ();
+			continue;
+		}
+
+		evict_ct++;
+		if (page_out (f->page))
+		{
+			policy_remove (f, true);
+			f->page = NULL;
+			return f;
+		}
+		lock_release (&f->lock);
+	}
+
+	return NULL;
+}
+
+/* Page cleaner thread.  While the pool is under pressure, writes
+   dirty pages in the CLEAN_AHEAD frames just ahead of the clock hand
+   to swap or back to their files and clears their dirty bits, so
+   that by the time the hand reaches them they can be evicted without
+   any I/O on the faulting thread's behalf.  Frames that are busy are
+   left alone.  The round's swap writes are made together, as one
+   swap batch, so the frames stay locked until it ends. */
+static void
+page_cleaner (void *aux UNUSED)
+{
+	unsigned seen_evict_ct = 0;
+
+	for (;;)
+	{
+		struct frame *locked[CLEAN_AHEAD];
+		size_t start, i, cnt;
+
+		timer_msleep (CLEAN_INTERVAL_MS);
+
+		/* Nothing to do until something has been evicted. */
+		if (evict_ct == seen_evict_ct)
+			continue;
+		seen_evict_ct = evict_ct;
+
+		start = hand;
+		cnt = 0;
+		swap_batch_begin ();
+		for (i = 0; i < CLEAN_AHEAD && i < frame_ct; i++)
+		{
+			struct frame *f = &frames[(start + i) % frame_ct];
+
+			if (!lock_try_acquire (&f->lock))
+				continue;
+			if (f->page != NULL)
+				page_clean (f->page);
+			locked[cnt++] = f;
+		}
+		swap_batch_end ();
+		for (i = 0; i < cnt; i++)
+			lock_release (&locked[i]->lock);
+	}
+}
+
+/* Returns F, which is locked and holds no page, to the user pool
+   and unlocks it. */
+static void
+frame_release (struct frame *f)
+{
+	ASSERT (f->page == NULL);
+
+	palloc_free_page (f->base);
+	lock_acquire (&scan_lock);
+	free_ct++;
+	lock_release (&scan_lock);
+	lock_release (&f->lock);
+}
+
+/* Reclaim thread.  Woken by frame_alloc() when the number of free
+   frames drops below low_wm, evicts pages until high_wm frames are
+   free, so that page faults find a free frame without having to
+   evict one themselves.  Evicts up to SWAP_BATCH_MAX pages at a time
+   as one swap batch, so that those going to swap are written
+   together, and frees their frames once the batch has ended. */
+static void
+frame_reclaim (void *aux UNUSED)
+{
+	for (;;)
+	{
+		sema_down (&reclaim_sema);
+
+		for (;;)
+		{
+			struct frame *batch[SWAP_BATCH_MAX];
+			size_t cnt, i;
+			bool stuck = false;
+			bool done;
+
+			lock_acquire (&scan_lock);
+			done = free_ct >= high_wm;
+			if (done)
+				reclaim_running = false;
+			lock_release (&scan_lock);
+			if (done)
+				break;
+
+			swap_batch_begin ();
+			for (cnt = 0; cnt < SWAP_BATCH_MAX; cnt++)
+			{
+				lock_acquire (&scan_lock);
+				done = free_ct + cnt >= high_wm;
+				lock_release (&scan_lock);
+				if (done)
+					break;
+
+				batch[cnt] = frame_evict (NULL);
+				if (batch[cnt] == NULL)
+				{
+					stuck = true;
+					break;
+				}
+			}
+			swap_batch_end ();
+			for (i = 0; i < cnt; i++)
+				frame_release (batch[i]);
+			reclaim_evict_ct += cnt;
+
+			if (stuck)
+			{
+				/* Nothing evictable right now; wait for the
+				   next allocation below the low watermark. */
+				lock_acquire (&scan_lock);
+				reclaim_running = false;
+				lock_release (&scan_lock);
+				break;
+			}
+		}
+	}
+}
+
+/* Allocates a user frame for PASSED_PAGE, honouring PAL_ZERO in
+   FLAGS.  If the user pool is exhausted, evicts another page to
+   make room.  Returns the frame with its lock held, or a null
+   pointer if PAL_USER is not set or nothing could be evicted. */
+struct frame *
 frame_alloc (enum palloc_flags flags, struct page *passed_page)
 {
+	struct frame *f;
+	void *free_page;
+
 	/* Following suit of palloc_get_page, we use a bitwise AND to determine if PAL_USER is set in flags. */
 	if ((flags & PAL_USER) == 0)
 		return NULL;
 
-	/* Get a single free page, if one is available, to find a kernel virtual base address for our newly allocated frame. */
-	void *free_page = palloc_get_page (flags);
+	/* A process at its resident set limit pages against itself,
+	   unless all of its frames are pinned: then it takes one from
+	   the global pool below and goes over its limit for a while. */
+	f = NULL;
+	if (over_rss_limit (passed_page->thread))
+	{
+		f = frame_evict (passed_page->thread);
+		if (f != NULL)
+			rss_evict_ct++;
+	}
 
-	if (free_page != NULL)
+	/* Get a single free page, if one is available, to find a kernel virtual base address for our newly allocated frame. */
+	if (f == NULL && (free_page = palloc_get_page (flags)) != NULL)
 	{
-		struct frame *new_frame = malloc(sizeof(struct frame));
-		new_frame->base = free_page;
-		new_frame->page = passed_page;
+		bool wake;
+
+		f = frame_for_kpage (free_page);
+		lock_acquire (&f->lock);
+
 		lock_acquire (&scan_lock);
+		free_ct--;
+		wake = free_ct < low_wm && !reclaim_running;
+		if (wake)
+			reclaim_running = true;
 		lock_release (&scan_lock);
+		if (wake)
+			sema_up (&reclaim_sema);
 	}
+	else if (f == NULL)
+	{
+		/* The reserve ran dry: evict on the faulting thread. */
+		sync_evict_ct++;
+		f = frame_evict (NULL);
+		if (f == NULL)
+			return NULL;
+		if (flags & PAL_ZERO)
+			memset (f->base, 0, PGSIZE);
+	}
+	else if (flags & PAL_ZERO)
+	{
+		/* Evicted from the process's own resident set. */
+		memset (f->base, 0, PGSIZE);
+	}
+	alloc_ct++;
 
+	ASSERT (f->page == NULL);
+	f->page = passed_page;
+	policy_install (f);
+	return f;
 }
 
 
@@ -46,11 +776,16 @@ frame_alloc (enum palloc_flags flags, struct page *passed_page)
 void frame_lock(struct page *page)
 {
 	struct frame *page_frame;
-	page_frame = page->frame;
 
-	if (page_frame != NULL)
+	while ((page_frame = page->frame) != NULL)
 	{
-		lock_acquire(page_frame->lock);
+		lock_acquire(&page_frame->lock);
+
+		/* The frame may have been evicted, or the page merged
+		   into another frame, while we waited. */
+		if (page_frame == page->frame)
+			return;
+		lock_release(&page_frame->lock);
 	}
 }
 
@@ -63,11 +798,135 @@ void frame_unlock(struct page *page)
 
 	if (page_frame != NULL)
 	{
-		lock_release(page_frame->lock);
+		ASSERT (lock_held_by_current_thread (&page_frame->lock));
+		lock_release(&page_frame->lock);
 	}
 }
 
+/* Releases FRAME, which must be locked by the caller, back to the
+   user pool. */
 void frame_free(struct frame *frame)
 {
+	ASSERT (lock_held_by_current_thread (&frame->lock));
+
+	share_remove (frame);
+	merge_remove (frame);
+	policy_remove (frame, false);
 	frame->page = NULL;
-}
\ No newline at end of file
+	frame_release (frame);
+}
+
+/* Maps frame F, which must be locked by the caller and already hold
+   a page, into page P as well.  F stays charged to its first page's
+   owner. */
+void
+frame_add_sharer (struct frame *f, struct page *p)
+{
+	ASSERT (lock_held_by_current_thread (&f->lock));
+	ASSERT (f->page != NULL);
+
+	p->frame = f;
+	p->next_sharer = f->page->next_sharer;
+	f->page->next_sharer = p;
+}
+
+/* Detaches page P from its frame, which must be locked by the
+   caller, and unlocks the frame.  If other pages still share the
+   frame it stays resident, charged to the next sharer's owner if P
+   was the first; otherwise it is freed. */
+void
+frame_unshare (struct page *p)
+{
+	struct frame *f = p->frame;
+
+	ASSERT (f != NULL);
+	ASSERT (lock_held_by_current_thread (&f->lock));
+
+	if (f->page == p && p->next_sharer == NULL)
+	{
+		frame_free (f);
+	}
+	else
+	{
+		if (f->page == p)
+			policy_hand_off (f, p->next_sharer);
+		else
+		{
+			struct page **pp = &f->page->next_sharer;
+			while (*pp != p)
+				pp = &(*pp)->next_sharer;
+			*pp = p->next_sharer;
+		}
+		lock_release (&f->lock);
+	}
+	p->frame = NULL;
+	p->next_sharer = NULL;
+}
+
+/* Evicts page P, if it is the only page mapping its frame, and
+   returns the frame to the user pool at once instead of waiting for
+   the replacement policy to find it.  Used for pages their process
+   has said it is done with.  Returns true if P lost its frame. */
+bool
+frame_drop (struct page *p)
+{
+	struct frame *f;
+
+	frame_lock (p);
+	f = p->frame;
+	if (f == NULL)
+		return false;
+
+	if (f->page == p && p->next_sharer == NULL && page_out (p))
+	{
+		policy_remove (f, false);
+		f->page = NULL;
+		frame_release (f);
+		return true;
+	}
+	lock_release (&f->lock);
+	return false;
+}
+
+/* Returns true if CNT more frames can go to thread T without any
+   eviction: T stays under its resident set limit and the free
+   reserve stays above the low watermark.  Only a hint, since it
+   reads the counts without scan_lock. */
+bool
+frame_can_spare (const struct thread *t, size_t cnt)
+{
+	return (t->rss_limit == 0 || t->resident_cnt + cnt < t->rss_limit)
+	       && free_ct >= low_wm + cnt;
+}
+
+/* Sets thread T's resident set limit to LIMIT pages, which must be
+   at least RSS_LIMIT_MIN, or removes it if LIMIT is 0, then evicts
+   T's pages until it is within the new limit.  T must be the running
+   thread. */
+void
+frame_set_rss_limit (struct thread *t, size_t limit)
+{
+	ASSERT (t == thread_current ());
+	ASSERT (limit == 0 || limit >= RSS_LIMIT_MIN);
+
+	t->rss_limit = limit;
+	while (limit != 0 && t->resident_cnt > limit)
+	{
+		struct frame *f = frame_evict (t);
+		if (f == NULL)
+			break;
+		rss_evict_ct++;
+		frame_release (f);
+	}
+}
+
+/* Prints frame allocation statistics. */
+void
+frame_print_stats (void)
+{
+	printf ("Frames: %lld allocations, %lld synchronous evictions, "
+	        "%lld reclaimed in background (watermarks %zu/%zu), "
+	        "%lld over resident set limits\n",
+	        alloc_ct, sync_evict_ct, reclaim_evict_ct, low_wm, high_wm,
+	        rss_evict_ct);
+}
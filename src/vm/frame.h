@@ -1,22 +1,70 @@
 #ifndef FRAME_H
 #define FRAME_H
 
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "vm/page.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+struct thread;
 
 /* A physical frame. */
-struct frame 
+struct frame
 {
 	struct lock lock;           /* Prevent simultaneous access. */
 	void *base;                 /* Kernel virtual base address. */
-	struct page *page;          /* Mapped process page, if any. */
+	struct page *page;          /* Mapped process page, if any.  Other
+	                               pages sharing the frame follow it
+	                               through their `next_sharer'. */
+
+	/* Replacement policy state, protected by scan_lock. */
+	uint8_t age;                /* Aging counter (lru-approx). */
+	bool hot;                   /* Hot page (clock-pro). */
+	struct list_elem queue_elem; /* Allocation order (fifo). */
+
+	/* Owner's resident set, protected by scan_lock. */
+	struct list_elem owner_elem; /* struct thread `frames' element. */
+
+	/* Shared file page cache (vm/share.c), protected by its lock. */
+	bool shared;                /* In the cache? */
+	struct hash_elem share_elem; /* Cache element. */
+	block_sector_t share_sector; /* Inode sector of the page's file. */
+	off_t share_offset;         /* Offset of the page in the file. */
+	off_t share_bytes;          /* Bytes read from the file. */
+
+	/* Same-page merging (vm/merge.c). */
+	bool merge_listed;          /* In the merge table?  Protected by its
+	                               lock. */
+	struct hash_elem merge_elem; /* Merge table element. */
+	unsigned merge_sum;         /* Contents checksum at the last visit,
+	                               the table key while listed. */
 };
 
-#endif // FRAME_H
+/* Smallest resident set limit a process may set.  One instruction
+   can touch a code page, a stack page and data pages on both sides
+   of a page boundary, and a system call keeps its buffer's current
+   pages pinned on top of that. */
+#define RSS_LIMIT_MIN 16
 
 /* Frame management function declarations */
-void frame_init (void);
-void* frame_alloc (enum palloc_flags, struct page *);
+void frame_init (size_t low_wm, size_t high_wm);
+bool frame_set_policy (const char *name);
+struct frame *frame_alloc (enum palloc_flags, struct page *);
+struct frame *frame_for_kpage (const void *kpage);
 void frame_lock (struct page *page);
 void frame_unlock (struct page *page);
 void frame_free (struct frame *frame);
+void frame_add_sharer (struct frame *, struct page *);
+void frame_unshare (struct page *);
+bool frame_drop (struct page *);
+bool frame_can_spare (const struct thread *, size_t cnt);
+void frame_set_rss_limit (struct thread *, size_t limit);
+void frame_print_stats (void);
+
+#endif // FRAME_H
@@ -0,0 +1,134 @@
+#include "vm/lz.h"
+#include <string.h>
+
+/* A small LZ77 compressor for swapped-out pages, which favours
+   speed over ratio.
+
+   The output is a sequence of groups, each a control byte followed
+   by up to 8 items, one per bit of the control byte, least
+   significant first.  A clear bit is a literal byte copied as is.
+   A set bit is a match of two bytes: the top 6 bits of the first
+   byte are the length less LZ_MATCH_MIN, and the remaining 10 bits
+   are how far back in the output the match starts.  A match may
+   overlap its own output, so runs compress well. */
+
+#define LZ_MATCH_MIN 3                          /* Shortest match. */
+#define LZ_MATCH_MAX (LZ_MATCH_MIN + 63)        /* Longest match. */
+#define LZ_OFFSET_MAX 1023                      /* Farthest match. */
+
+/* Hashes the LZ_MATCH_MIN bytes at P. */
+static unsigned
+lz_hash (const uint8_t *p)
+{
+  unsigned h = p[0] | (p[1] << 8) | (p[2] << 16);
+  return ((h * 2654435761u) >> 16) % LZ_HASH_SIZE;
+}
+
+/* Compresses the SRC_SIZE bytes at SRC into the DST_SIZE bytes at
+   DST, using WORK as scratch space.  Returns the compressed size,
+   or 0 if it would not fit in DST_SIZE bytes. */
+size_t
+lz_compress (const void *src_, size_t src_size,
+             void *dst_, size_t dst_size, struct lz_work *work)
+{
+  const uint8_t *src = src_;
+  uint8_t *dst = dst_;
+  size_t ip = 0, op = 0;
+  size_t ctl = 0;
+  int bit = 8;
+
+  /* Table entries hold a position plus 1, or 0 for none. */
+  memset (work->table, 0, sizeof work->table);
+
+  while (ip < src_size)
+    {
+      if (bit == 8)
+        {
+          if (op >= dst_size)
+            return 0;
+          ctl = op++;
+          dst[ctl] = 0;
+          bit = 0;
+        }
+
+      if (ip + LZ_MATCH_MIN <= src_size)
+        {
+          unsigned h = lz_hash (src + ip);
+          size_t cand = work->table[h];
+
+          work->table[h] = ip + 1;
+          if (cand != 0 && ip - (cand - 1) <= LZ_OFFSET_MAX
+              && !memcmp (src + cand - 1, src + ip, LZ_MATCH_MIN))
+            {
+              size_t offset = ip - (cand - 1);
+              size_t len = LZ_MATCH_MIN;
+
+              while (len < LZ_MATCH_MAX && ip + len < src_size
+                     && src[cand - 1 + len] == src[ip + len])
+                len++;
+              if (op + 2 > dst_size)
+                return 0;
+              dst[ctl] |= 1 << bit;
+              dst[op++] = ((len - LZ_MATCH_MIN) << 2) | (offset >> 8);
+              dst[op++] = offset & 0xff;
+              ip += len;
+              bit++;
+              continue;
+            }
+        }
+
+      if (op >= dst_size)
+        return 0;
+      dst[op++] = src[ip++];
+      bit++;
+    }
+  return op;
+}
+
+/* Decompresses the SRC_SIZE bytes at SRC, produced by
+   lz_compress(), into the DST_SIZE bytes at DST.  Returns the
+   decompressed size, or 0 if SRC is corrupt or does not fit. */
+size_t
+lz_decompress (const void *src_, size_t src_size,
+               void *dst_, size_t dst_size)
+{
+  const uint8_t *src = src_;
+  uint8_t *dst = dst_;
+  size_t ip = 0, op = 0;
+  uint8_t ctl = 0;
+  int bit = 8;
+
+  while (ip < src_size)
+    {
+      if (bit == 8)
+        {
+          ctl = src[ip++];
+          bit = 0;
+          if (ip >= src_size)
+            return 0;
+        }
+
+      if (ctl & (1 << bit))
+        {
+          size_t len, offset;
+
+          if (ip + 2 > src_size)
+            return 0;
+          len = (src[ip] >> 2) + LZ_MATCH_MIN;
+          offset = ((src[ip] & 3) << 8) | src[ip + 1];
+          ip += 2;
+          if (offset == 0 || offset > op || len > dst_size - op)
+            return 0;
+          for (; len > 0; len--, op++)
+            dst[op] = dst[op - offset];
+        }
+      else
+        {
+          if (op >= dst_size)
+            return 0;
+          dst[op++] = src[ip++];
+        }
+      bit++;
+    }
+  return op;
+}
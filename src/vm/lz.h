@@ -0,0 +1,21 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Entries in the hash table lz_compress() uses to find matches. */
+#define LZ_HASH_SIZE 1024
+
+/* Scratch space for lz_compress(). */
+struct lz_work
+  {
+    uint16_t table[LZ_HASH_SIZE];
+  };
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size, struct lz_work *);
+size_t lz_decompress (const void *src, size_t src_size,
+                      void *dst, size_t dst_size);
+
+#endif // LZ_H
@@ -0,0 +1,176 @@
+#include "vm/merge.h"
+#include <debug.h>
+#include <hash.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "vm/page.h"
+
+/* Same-page merging.  A low-priority thread walks the user pool,
+   checksumming the frames of private, writable pages.  A frame
+   whose checksum has not changed since the last visit is taken to
+   be rarely written and is looked up by checksum in merge_table:
+   if another frame there holds the same bytes, the page is remapped
+   copy-on-write to that frame and its own frame is freed; if not,
+   the frame is entered in the table for later pages to find.
+
+   Frames enter the table still writable.  Only when a match turns
+   up are the table frame's pages made copy-on-write, after which
+   the contents are compared again; the first write to any of them
+   then gives the writer its own copy (see page_break_cow()).
+
+   Lock order: a frame's lock may be held while acquiring
+   merge_lock, so the scanner only ever tries frame locks. */
+static struct hash merge_table;
+static struct lock merge_lock;
+
+/* Frames examined per round, and how long the scanner sleeps
+   between rounds. */
+#define MERGE_BATCH 64
+#define MERGE_INTERVAL_MS 100
+
+static void merge_scanner (void *aux);
+
+static unsigned
+merge_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_entry (e, struct frame, merge_elem)->merge_sum;
+}
+
+static bool
+merge_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct frame, merge_elem)->merge_sum
+          < hash_entry (b, struct frame, merge_elem)->merge_sum);
+}
+
+/* Initializes same-page merging and starts the scanner thread.
+   Must be called after frame_init(). */
+void
+merge_init (void)
+{
+  hash_init (&merge_table, merge_hash, merge_less, NULL);
+  lock_init (&merge_lock);
+  thread_create ("pagemerge", PRI_MIN, merge_scanner, NULL);
+}
+
+/* Withdraws frame F, which must be locked by the caller, from the
+   merge table before its contents may change. */
+void
+merge_remove (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  if (f->merge_listed)
+    {
+      lock_acquire (&merge_lock);
+      hash_delete (&merge_table, &f->merge_elem);
+      f->merge_listed = false;
+      lock_release (&merge_lock);
+    }
+}
+
+/* Returns true if the page in frame F, which must be locked, may
+   be merged: F maps only that page, which is writable and holds
+   private data rather than a shared file mapping. */
+static bool
+merge_candidate (const struct frame *f)
+{
+  const struct page *p = f->page;
+
+  return p != NULL && p->next_sharer == NULL && !p->read_only
+         && (p->file == NULL || p->private);
+}
+
+/* Examines frame F, which must be locked by the caller, as
+   described at the top of this file.  Returns true if F's page was
+   merged into another frame, which frees F and releases its lock;
+   otherwise F stays locked. */
+static bool
+merge_scan_frame (struct frame *f)
+{
+  struct frame *g;
+  struct hash_elem *e;
+  unsigned sum;
+  bool merged;
+
+  if (!merge_candidate (f))
+    return false;
+
+  sum = hash_bytes (f->base, PGSIZE);
+  if (f->merge_listed || sum != f->merge_sum)
+    {
+      /* Written since the last visit, or already waiting. */
+      if (sum != f->merge_sum)
+        {
+          merge_remove (f);
+          f->merge_sum = sum;
+        }
+      return false;
+    }
+
+  lock_acquire (&merge_lock);
+  e = hash_find (&merge_table, &f->merge_elem);
+  if (e == NULL)
+    {
+      hash_insert (&merge_table, &f->merge_elem);
+      f->merge_listed = true;
+      lock_release (&merge_lock);
+      return false;
+    }
+  g = hash_entry (e, struct frame, merge_elem);
+  if (lock_held_by_current_thread (&g->lock)
+      || !lock_try_acquire (&g->lock))
+    {
+      lock_release (&merge_lock);
+      return false;
+    }
+  lock_release (&merge_lock);
+
+  /* A table frame that was written since it was listed gives way
+     to F. */
+  if (hash_bytes (g->base, PGSIZE) != sum)
+    {
+      merge_remove (g);
+      lock_release (&g->lock);
+      lock_acquire (&merge_lock);
+      f->merge_listed = hash_insert (&merge_table, &f->merge_elem) == NULL;
+      lock_release (&merge_lock);
+      return false;
+    }
+
+  merged = page_merge (f->page, g);
+  lock_release (&g->lock);
+  return merged;
+}
+
+/* Same-page merging thread. */
+static void
+merge_scanner (void *aux UNUSED)
+{
+  uint8_t *base = palloc_user_base ();
+  size_t frame_cnt = palloc_user_page_cnt ();
+  size_t next = 0;
+
+  for (;;)
+    {
+      size_t i;
+
+      timer_msleep (MERGE_INTERVAL_MS);
+
+      for (i = 0; i < MERGE_BATCH && i < frame_cnt; i++)
+        {
+          struct frame *f = frame_for_kpage (base + next * PGSIZE);
+
+          if (++next >= frame_cnt)
+            next = 0;
+          if (!lock_try_acquire (&f->lock))
+            continue;
+          if (!merge_scan_frame (f))
+            lock_release (&f->lock);
+        }
+    }
+}
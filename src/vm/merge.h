@@ -0,0 +1,9 @@
+#ifndef MERGE_H
+#define MERGE_H
+
+#include "vm/frame.h"
+
+void merge_init (void);
+void merge_remove (struct frame *);
+
+#endif // MERGE_H
@@ -1,8 +1,13 @@
 #include "vm/page.h"
+#include <stdio.h>
+#include <string.h>
 #include "vm/frame.h"
+#include "vm/merge.h"
+#include "vm/share.h"
 #include "vm/swap.h"
-#include "threads/malloc.h"
+#include "vm/vmstat.h"
 #include "threads/palloc.h"
+#include "threads/pte.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
@@ -10,102 +15,1147 @@
 #include "userprog/syscall.h"
 #include "threads/interrupt.h"
 
-bool 
-page_hash_less_function (const struct hash_elem*first, const struct hash_elem*second, void *aux UNUSED) 
+/* Most neighbouring pages mapped by one fault-around. */
+#define FAULT_AROUND_MAX 16
+
+/* Most stack pages grown by one fault, and how far below the
+   stack's lowest page a fault may land and still count as the
+   stack running on downward rather than jumping. */
+#define STACK_GROW_MAX 16
+#define STACK_NEAR (4 * PGSIZE)
+
+/* Stack pages reserved for a process that has not asked for a
+   particular number. */
+static size_t default_stack_reserve;
+
+/* A permanently zeroed frame, mapped read-only into every page
+   that has been read but never written, until its first write
+   fault gives the page a private frame. */
+static void *zero_page;
+
+/* Pool of page descriptors, carved out of whole kernel pages so
+   that page tables stay out of malloc()'s size classes.  Free
+   descriptors are chained through `next_sharer'.  Pages taken for
+   the pool are kept in it for reuse. */
+static struct lock pool_lock;
+static struct page *pool_free;
+
+/* Initializes the supplemental page table module.  New processes
+   get STACK_PAGES of stack unless they ask otherwise. */
+void
+page_init (size_t stack_pages)
+{
+    default_stack_reserve = stack_pages;
+    zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+    lock_init (&pool_lock);
+    share_init ();
+}
+
+/* Returns an uninitialized page descriptor from the pool, or a
+   null pointer if memory is exhausted. */
+static struct page *
+page_desc_alloc (void)
 {
-    struct page *first_ptr = hash_entry(first, struct page, elem);
-    struct page *second_ptr = hash_entry(second, struct page, elem);
-    if (first_ptr->addr < second_ptr->addr)
+    struct page *p;
+
+    lock_acquire (&pool_lock);
+    if (pool_free == NULL)
     {
-        return true;
+        struct page *slab = palloc_get_page (0);
+        size_t i;
+
+        for (i = 0; slab != NULL && i < PGSIZE / sizeof *slab; i++)
+        {
+            slab[i].next_sharer = pool_free;
+            pool_free = &slab[i];
+        }
     }
+    p = pool_free;
+    if (p != NULL)
+        pool_free = p->next_sharer;
+    lock_release (&pool_lock);
+    return p;
+}
 
-    return false;
+/* Returns page descriptor P to the pool. */
+static void
+page_desc_free (struct page *p)
+{
+    lock_acquire (&pool_lock);
+    p->next_sharer = pool_free;
+    pool_free = p;
+    lock_release (&pool_lock);
+}
+
+/* Detaches page P, already marked not present, from its frame,
+   which must be locked by the caller, and unlocks the frame.  P's
+   dirty bit is passed on to the pages still sharing the frame, so
+   that the shared data is not mistaken for clean. */
+static void
+page_detach (struct page *p)
+{
+    struct page *s;
+
+    if (pagedir_is_dirty (p->thread->pagedir, p->addr))
+        for (s = p->frame->page; s != NULL; s = s->next_sharer)
+            if (s != p)
+                pagedir_set_dirty (s->thread->pagedir, s->addr, true);
+    frame_unshare (p);
 }
 
-void 
-page_hash_action_function(struct hash_elem*el, void *aux UNUSED) {
-    struct page *page_ptr = hash_entry (el, struct page, elem);
+/* Gives up page P's contents: its mapping, frame and swap slot are
+   released at once, so that it next reads back from the file it
+   came from, even after it went to swap, or as zeros if it has
+   none.  Changes to a shared file mapping are written
+   back first, since they belong to the file. */
+static void
+page_discard (struct page *p)
+{
+    uint32_t *pd = p->thread->pagedir;
 
-    if (page_ptr->frame != NULL) 
+    frame_lock (p);
+    if (p->frame != NULL)
+    {
+        struct frame *f = p->frame;
+
+        pagedir_clear_page (pd, p->addr);
+        if (p->file != NULL && !p->private && f->page == p
+            && p->next_sharer == NULL && pagedir_is_dirty (pd, p->addr))
+            file_write_at (p->file, f->base, p->file_bytes, p->file_offset);
+        p->cow = false;
+        page_detach (p);
+    }
+    else if (p->zero_mapped)
     {
-        frame_free (pagedir_get_page (thread_current()->pagedir, page->addr));
-        pagedir_clean_page (thread_current()->pagedir, page->addr);
+        /* Keep pagedir_destroy() from freeing the zero frame. */
+        pagedir_clear_page (pd, p->addr);
+        p->zero_mapped = false;
     }
+    swap_free (p);
+    p->file_stale = false;
+}
 
-    free (page_ptr);
+/* Releases page P's frame, mapping and swap slot, and frees it. */
+static void
+page_destroy (struct page *p)
+{
+    page_discard (p);
+    page_desc_free (p);
+}
 
+/* Creates an empty page table.  Returns a null pointer if memory
+   is exhausted. */
+struct page_table *
+page_table_create (void)
+{
+    return palloc_get_page (PAL_ZERO);
 }
 
-unsigned 
-page_hash_hash_function (const struct hash_elem*el, void*aux UNUSED) 
+/* Adds to the running process a copy of page PP of PARENT for
+   fork(), as described at page_table_fork().  Returns true if
+   successful. */
+static bool
+page_fork (struct thread *parent, struct page *pp, struct file *exe)
 {
-    struct page* ptr = hash_entry(el, struct page, elem);
-    return(hash_int((int) ptr->addr));
+    struct page *cp;
+    bool ok = true;
+
+    if (syscall_is_mapped (parent, pp->addr))
+        return true;
+
+    cp = page_allocate (pp->addr, pp->read_only);
+    if (cp == NULL)
+        return false;
+
+    cp->advice = pp->advice;
+    frame_lock (pp);
+    cp->private = pp->private;
+    cp->file = pp->file != NULL ? exe : NULL;
+    cp->file_offset = pp->file_offset;
+    cp->file_bytes = pp->file_bytes;
+    cp->file_stale = pp->file_stale;
+    swap_dup (cp, pp);
+    if (pp->frame != NULL)
+    {
+        frame_add_sharer (pp->frame, cp);
+        if (!pp->read_only)
+        {
+            pagedir_set_writable (parent->pagedir, pp->addr, false);
+            pp->cow = cp->cow = true;
+        }
+        ok = pagedir_set_page (thread_current ()->pagedir, cp->addr,
+                               cp->frame->base, false);
+    }
+    frame_unlock (pp);
+    return ok;
 }
 
+/* Copies the page table of PARENT, which must be blocked waiting
+   for the copy, into the running process for fork().  Resident
+   pages share PARENT's frames, with writable ones mapped read-only
+   in both processes until one of them writes; swapped-out pages
+   share PARENT's swap slots.  Pages backed by PARENT's executable
+   are backed by EXE, the child's own handle on it.  Pages of PARENT's
+   memory mappings are not inherited, since the mappings are not,
+   whether or not they still refer to their file.  Returns true if
+   successful. */
+bool
+page_table_fork (struct thread *parent, struct file *exe)
+{
+    struct page_table *pt = parent->pages;
+    size_t d, i;
+
+    for (d = 0; d < PAGE_DIR_CNT; d++)
+        if (pt->tables[d] != NULL)
+            for (i = 0; i < PAGE_TABLE_CNT; i++)
+                if (pt->tables[d][i] != NULL
+                    && !page_fork (parent, pt->tables[d][i], exe))
+                    return false;
+    return true;
+}
+
+/* Destroys the page table PT of the current process, releasing
+   every frame and swap slot its pages hold. */
 void
-page_table_intialization (struct hash *ptr) 
+page_table_destroy (struct page_table *pt)
+{
+    size_t d, i;
+
+    for (d = 0; d < PAGE_DIR_CNT; d++)
+        if (pt->tables[d] != NULL)
+        {
+            for (i = 0; i < PAGE_TABLE_CNT; i++)
+                if (pt->tables[d][i] != NULL)
+                    page_destroy (pt->tables[d][i]);
+            palloc_free_page (pt->tables[d]);
+        }
+    palloc_free_page (pt);
+}
+
+/* Returns the current process's page containing user virtual
+   address ADDR, or a null pointer if there is none. */
+struct page *
+find_page (const void *addr)
+{
+    struct page_table *pt = thread_current ()->pages;
+    struct page **table;
+
+    if (pt == NULL || !is_user_vaddr (addr))
+        return NULL;
+
+    table = pt->tables[pd_no (addr)];
+    return table != NULL ? table[pt_no (addr)] : NULL;
+}
+
+/* Returns the page DELTA pages away from page P in P's process, if
+   it exists and lies within the same second-level table as P, or a
+   null pointer.  May be called from any thread that holds P's frame
+   lock, since P's table is not freed before P is destroyed, which
+   takes that lock; but the page returned may be changing, so the
+   caller may only take hints from it. */
+struct page *
+page_neighbor (const struct page *p, int delta)
 {
-    hash_init (ptr, page_hash_hash_function, page_hash_less_function, NULL);
+    uint8_t *addr = (uint8_t *) p->addr + delta * PGSIZE;
+
+    if (!is_user_vaddr (addr) || pd_no (addr) != pd_no (p->addr))
+        return NULL;
+    return p->thread->pages->tables[pd_no (addr)][pt_no (addr)];
 }
 
+/* Removes the current process's page at user virtual address
+   VADDR, if any, as page_discard() describes, and frees it. */
 void
-page_table_destroy (struct hash *ptr) 
+page_deallocate (void *vaddr)
+{
+    struct page *p = find_page (vaddr);
+
+    if (p != NULL)
+    {
+        thread_current ()->pages->tables[pd_no (vaddr)][pt_no (vaddr)] = NULL;
+        page_destroy (p);
+    }
+}
+
+/* Adds a page at user virtual address VADDR to the current
+   process's page table.  The page starts out as zero-filled
+   anonymous memory with no frame.  Returns the new page, or a
+   null pointer if memory is exhausted or VADDR is already
+   mapped. */
+struct page *
+page_allocate (void *vaddr, bool read_only)
+{
+    struct page_table *pt = thread_current ()->pages;
+    struct page **table;
+    struct page *new_page;
+
+    ASSERT (is_user_vaddr (vaddr));
+
+    table = pt->tables[pd_no (vaddr)];
+    if (table == NULL)
+    {
+        table = pt->tables[pd_no (vaddr)] = palloc_get_page (PAL_ZERO);
+        if (table == NULL)
+            return NULL;
+    }
+    if (table[pt_no (vaddr)] != NULL)
+        return NULL;
+
+    new_page = page_desc_alloc ();
+    if (new_page == NULL)
+        return NULL;
+
+    new_page->addr = pg_round_down (vaddr);
+    new_page->read_only = read_only;
+    new_page->thread = thread_current ();
+    new_page->zero_mapped = false;
+    new_page->advice = MADV_NORMAL;
+    new_page->frame = NULL;
+    new_page->next_sharer = NULL;
+    new_page->cow = false;
+    new_page->sector = (block_sector_t) -1;
+    new_page->private = !read_only;
+    new_page->file = NULL;
+    new_page->file_offset = 0;
+    new_page->file_bytes = 0;
+    new_page->file_stale = false;
+
+    table[pt_no (vaddr)] = new_page;
+    return new_page;
+}
+
+/* Maps page P, whose frame must be locked by the caller, into the
+   current process's page directory, replacing any mapping of the
+   zero frame.  Returns true if successful. */
+static bool
+page_install (struct page *p)
+{
+    uint32_t *pd = thread_current ()->pagedir;
+
+    if (p->zero_mapped)
+    {
+        pagedir_clear_page (pd, p->addr);
+        p->zero_mapped = false;
+    }
+    return pagedir_set_page (pd, p->addr, p->frame->base,
+                             !p->read_only && !p->cow);
+}
+
+/* Gives the running process's page DELTA pages away from page P a
+   locked frame, for page_swap_in() to read it into, if that page is
+   not resident, holds the swap slot DELTA slots away from P's, and
+   can have a frame without any eviction.  Returns true if
+   successful. */
+static bool
+page_swap_readahead (struct page *p, int delta)
+{
+    struct page *n = page_neighbor (p, delta);
+
+    if (n == NULL || n->frame != NULL || n->advice == MADV_RANDOM
+        || n->sector != p->sector + delta * PAGE_SECTORS
+        || !frame_can_spare (n->thread, 1))
+        return false;
+    n->frame = frame_alloc (PAL_USER, n);
+    return n->frame != NULL;
+}
+
+/* Reads page P, which belongs to the running process and whose
+   frame is locked, back from swap.  Unless P was advised
+   MADV_RANDOM, the neighbouring pages whose slots continue P's run
+   of adjacent slots, up to SWAP_CLUSTER pages in all, are read in
+   the same pass and mapped, so that a process that was swapped out
+   in order comes back in with one read per cluster. */
+static void
+page_swap_in (struct page *p)
+{
+    struct page *run[SWAP_CLUSTER];
+    int lo = 0, hi = 0;
+    int d;
+
+    if (p->advice != MADV_RANDOM)
+    {
+        while (hi - lo + 1 < SWAP_CLUSTER && page_swap_readahead (p, hi + 1))
+            hi++;
+        while (hi - lo + 1 < SWAP_CLUSTER && page_swap_readahead (p, lo - 1))
+            lo--;
+    }
+
+    for (d = lo; d <= hi; d++)
+        run[d - lo] = d == 0 ? p : page_neighbor (p, d);
+    swap_in_cluster (run, hi - lo + 1);
+
+    for (d = lo; d <= hi; d++)
+        if (d != 0)
+        {
+            struct page *n = run[d - lo];
+
+            /* Left resident but unmapped on failure; the next fault
+               maps it. */
+            if (page_install (n))
+                vm_stats.swap_readahead++;
+            frame_unlock (n);
+        }
+}
+
+/* Gives page P a frame and fills it from swap, its file, or with
+   zeros, or maps the frame of another process that already holds
+   the same read-only file data.  Returns true with P's frame locked
+   if successful. */
+static bool
+do_page_in (struct page *p)
+{
+    if (share_eligible (p))
+    {
+        struct frame *f = share_find (p);
+        if (f != NULL)
+        {
+            frame_add_sharer (f, p);
+            vm_stats.shared_maps++;
+            return true;
+        }
+    }
+
+    p->frame = frame_alloc (PAL_USER, p);
+    if (p->frame == NULL)
+        return false;
+
+    if (p->sector != (block_sector_t) -1)
+    {
+        page_swap_in (p);
+    }
+    else if (p->file != NULL)
+    {
+        off_t read_bytes = file_read_at (p->file, p->frame->base,
+                                         p->file_bytes, p->file_offset);
+        memset ((uint8_t *) p->frame->base + read_bytes, 0, PGSIZE - read_bytes);
+        if (read_bytes != p->file_bytes)
+            printf ("bytes read (%"PROTd") != bytes requested (%"PROTd")\n",
+                    read_bytes, p->file_bytes);
+        else if (share_eligible (p))
+            share_add (p->frame);
+    }
+    else
+    {
+        memset (p->frame->base, 0, PGSIZE);
+    }
+
+    return true;
+}
+
+/* Brings page P into memory, if necessary, and maps it into the
+   current process's page directory.  Returns true if successful. */
+static bool
+page_map (struct page *p)
+{
+    bool success;
+
+    frame_lock (p);
+    if (p->frame == NULL && !do_page_in (p))
+        return false;
+    ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+    success = page_install (p);
+
+    frame_unlock (p);
+    return success;
+}
+
+/* Gives copy-on-write page P, whose frame must be locked by the
+   caller, a frame it may write.  If P is the frame's last sharer it
+   just becomes writable; otherwise it gets a private copy, which is
+   left locked.  Returns true if successful. */
+static bool
+page_break_cow (struct page *p)
+{
+    uint32_t *pd = p->thread->pagedir;
+    struct frame *old = p->frame;
+    struct frame *new;
+
+    ASSERT (p->cow);
+    ASSERT (lock_held_by_current_thread (&old->lock));
+
+    vm_stats.cow_faults++;
+    if (old->page == p && p->next_sharer == NULL)
+    {
+        merge_remove (old);
+        pagedir_set_writable (pd, p->addr, true);
+        p->cow = false;
+        return true;
+    }
+
+    new = frame_alloc (PAL_USER, p);
+    if (new == NULL)
+        return false;
+    memcpy (new->base, old->base, PGSIZE);
+    pagedir_clear_page (pd, p->addr);
+    page_detach (p);
+    p->frame = new;
+    p->cow = false;
+    if (!pagedir_set_page (pd, p->addr, new->base, true))
+        return false;
+
+    /* The copy may be newer than P's swap slot or file. */
+    pagedir_set_dirty (pd, p->addr, true);
+    return true;
+}
+
+/* Maps never-written anonymous page P read-only to the zero frame,
+   deferring a private frame until the first write fault. */
+static bool
+page_map_zero (struct page *p)
+{
+    if (!pagedir_set_page (thread_current ()->pagedir, p->addr,
+                           zero_page, false))
+        return false;
+    p->zero_mapped = true;
+    return true;
+}
+
+/* Releases the frames of the FAULT_AROUND_MAX pages that lie a
+   full window behind page P, a page being read sequentially, so
+   that a MADV_SEQUENTIAL reader streams through memory instead of
+   pushing other processes' pages out. */
+static void
+page_drop_behind (struct page *p)
+{
+    size_t i;
+
+    for (i = FAULT_AROUND_MAX + 1; i <= 2 * FAULT_AROUND_MAX; i++)
+    {
+        struct page *b;
+
+        if ((uintptr_t) p->addr < i * PGSIZE)
+            break;
+        b = find_page ((uint8_t *) p->addr - i * PGSIZE);
+        if (b != NULL && b->advice == MADV_SEQUENTIAL && b->file == p->file)
+            frame_drop (b);
+    }
+}
+
+/* After a fault on file-backed page P, maps the pages that follow
+   it in the same file, so that a sequential reader takes one trap
+   per window instead of one per page.  The window doubles, up to
+   FAULT_AROUND_MAX, each time a fault lands just past the previous
+   window and halves whenever one lands elsewhere.  Stops early
+   rather than evict anything for a speculative page.  Pages advised
+   MADV_RANDOM get no fault-around; pages advised MADV_SEQUENTIAL
+   get the largest window at once and drop the pages behind it. */
+static void
+page_fault_around (struct page *p)
+{
+    struct thread *t = thread_current ();
+    size_t i;
+
+    if (p->advice == MADV_RANDOM)
+        return;
+
+    if (p->advice == MADV_SEQUENTIAL)
+    {
+        t->fault_window = FAULT_AROUND_MAX;
+        page_drop_behind (p);
+    }
+    else if (p->addr == t->fault_next)
+        t->fault_window = t->fault_window == 0 ? 1 : t->fault_window * 2;
+    else
+        t->fault_window /= 2;
+    if (t->fault_window > FAULT_AROUND_MAX)
+        t->fault_window = FAULT_AROUND_MAX;
+
+    for (i = 1; i <= t->fault_window; i++)
+    {
+        struct page *n = find_page ((uint8_t *) p->addr + i * PGSIZE);
+
+        if (n == NULL || n->file != p->file
+            || n->file_offset != p->file_offset + (off_t) (i * PGSIZE)
+            || n->frame != NULL || n->zero_mapped
+            || n->sector != (block_sector_t) -1
+            || !frame_can_spare (t, 1) || !page_map (n))
+            break;
+        vm_stats.fault_around++;
+    }
+    t->fault_next = (uint8_t *) p->addr + i * PGSIZE;
+}
+
+/* Faults in the page containing FAULT_ADDR and maps it into the
+   current process's page directory.  WRITE says whether the fault
+   was caused by a write, which for a page mapped to the zero frame
+   means it now needs a private copy.  START is the timestamp from
+   vmstat_fault_begin() at which the fault was taken; the latency of
+   a fault that succeeds is recorded under its class.  Returns true
+   if successful, false if FAULT_ADDR has no page, the access is not
+   allowed, or no frame could be found. */
+bool
+page_in (void *fault_addr, bool write, uint64_t start)
+{
+    struct page *p = find_page (fault_addr);
+    enum fault_class class;
+    bool success;
+
+    if (p == NULL || (write && p->read_only))
+        return false;
+
+    if (write && p->cow)
+    {
+        frame_lock (p);
+        if (p->frame != NULL)
+        {
+            success = page_break_cow (p);
+            frame_unlock (p);
+            if (success)
+                vmstat_fault_end (FAULT_COW, start);
+            return success;
+        }
+        /* Evicted meanwhile: page it back in privately. */
+    }
+
+    if (p->zero_mapped)
+    {
+        if (!write)
+            return false;
+        vm_stats.zero_faults++;
+        class = FAULT_ZERO;
+    }
+    else if (p->sector != (block_sector_t) -1)
+    {
+        vm_stats.swap_faults++;
+        class = FAULT_SWAP;
+    }
+    else if (p->file != NULL)
+    {
+        vm_stats.file_faults++;
+        class = FAULT_FILE;
+        if (!page_map (p))
+            return false;
+        page_fault_around (p);
+        vmstat_fault_end (class, start);
+        return true;
+    }
+    else
+    {
+        vm_stats.zero_faults++;
+        class = FAULT_ZERO;
+        if (p->frame == NULL && !write)
+        {
+            success = page_map_zero (p);
+            if (success)
+                vmstat_fault_end (class, start);
+            return success;
+        }
+    }
+
+    success = page_map (p);
+    if (success)
+        vmstat_fault_end (class, start);
+    return success;
+}
+
+/* Returns true if any page mapping frame F, which must be locked,
+   has dirtied it. */
+static bool
+frame_is_dirty (const struct frame *f)
 {
-    hash_destroy (ptr, page_hash_action_function);
+    const struct page *s;
+
+    for (s = f->page; s != NULL; s = s->next_sharer)
+        if (pagedir_is_dirty (s->thread->pagedir, s->addr))
+            return true;
+    return false;
 }
 
+/* Sets the dirty bit of every page mapping frame F, which must be
+   locked, to DIRTY. */
+static void
+frame_set_dirty (struct frame *f, bool dirty)
+{
+    struct page *s;
+
+    for (s = f->page; s != NULL; s = s->next_sharer)
+        pagedir_set_dirty (s->thread->pagedir, s->addr, dirty);
+}
 
-struct page * 
-find_page (void *addr) 
+/* Returns true if page P, the first page of its frame, and every
+   other page sharing the frame have an up-to-date copy in their file
+   or in swap, so that the frame can be dropped without any I/O.  A
+   swap copy is usually the slot a page kept when it was swapped in
+   (see swap_in_cluster()) or the one the page cleaner wrote.  DIRTY
+   says whether the frame was modified since it was last written
+   back. */
+static bool
+page_has_clean_copy (const struct page *p, bool dirty)
 {
-    struct thread *curr = thread_current();
-    struct page page;
-    struct page *found_page = NULL;
-    page.addr = pg_round_down (addr);
+    const struct page *s;
 
-    struct hash_elem *elem;
+    if (dirty)
+        return false;
+    for (s = p; s != NULL; s = s->next_sharer)
+        if ((s->file == NULL || s->file_stale)
+            && s->sector == (block_sector_t) -1)
+            return false;
+    return true;
+}
 
-    e = hash_find(&curr->pages, &p.hash_elem);
+/* After swap_out() wrote page P, the first page of its frame,
+   makes every other page sharing the frame hold the same slot, in
+   place of any file data they started from. */
+static void
+sharers_follow_swap (struct page *p)
+{
+    struct page *s;
 
-    // Retrieve the entry
-    if (!e) 
+    for (s = p->next_sharer; s != NULL; s = s->next_sharer)
     {
-        found_page = hash_entry(e, struct page, hash_elem);
+        if (s->sector != p->sector)
+        {
+            swap_free (s);
+            swap_dup (s, p);
+        }
+        s->file_stale = true;
     }
+}
 
-    return found_page;
-};
+/* Evicts page P, which must be the first page of its frame, whose
+   lock must be held by the caller.  Dirty shared file pages are
+   written back to their file, other dirty or anonymous pages go to
+   swap, and pages that already have a clean copy (see page_clean())
+   are simply dropped.  Returns true if successful; P and every page
+   sharing its frame then have no frame. */
+bool
+page_out (struct page *p)
+{
+    struct frame *f = p->frame;
+    struct page *s;
+    bool dirty;
+    bool ok;
 
+    ASSERT (f != NULL);
+    ASSERT (f->page == p);
+    ASSERT (lock_held_by_current_thread (&f->lock));
+
+    /* Mark page not present first, in every process sharing it, so
+       that no process can dirty it again behind our back. */
+    for (s = p; s != NULL; s = s->next_sharer)
+        pagedir_clear_page (s->thread->pagedir, s->addr);
+
+    dirty = frame_is_dirty (f);
+
+    if (p->file != NULL && !p->private)
+    {
+        ok = !dirty || file_write_at (p->file, p->frame->base, p->file_bytes,
+                                      p->file_offset) == p->file_bytes;
+    }
+    else if (page_has_clean_copy (p, dirty))
+    {
+        ok = true;
+        dirty = false;
+    }
+    else
+    {
+        ok = swap_out (p);
+        if (ok)
+            sharers_follow_swap (p);
+        dirty = true;
+    }
+
+    if (ok)
+    {
+        share_remove (f);
+        merge_remove (f);
+        while (p != NULL)
+        {
+            s = p->next_sharer;
+            p->frame = NULL;
+            p->next_sharer = NULL;
+            p->cow = false;
+            p = s;
+        }
+        if (dirty)
+            vm_stats.dirty_evictions++;
+        else
+            vm_stats.clean_evictions++;
+    }
+    return ok;
+}
+
+/* Writes resident page P, whose frame must be locked by the caller,
+   to its backing store if it has no clean copy there, and clears
+   its dirty bit, so that a later page_out() needs no I/O.  The page
+   stays mapped.  Returns true if P is clean afterward. */
 bool
-stack_grow (void *user_addr)
+page_clean (struct page *p)
 {
-    if ((size_t) (PHYS_BASE - pg_round_down(user_addr)) > STACK_LIMIT)
+    bool dirty;
+    bool ok;
+
+    ASSERT (p->frame != NULL);
+    ASSERT (p->frame->page == p);
+    ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+    dirty = frame_is_dirty (p->frame);
+    if (page_has_clean_copy (p, dirty))
+        return true;
+
+    /* Clear the dirty bit before writing, so that a store by the
+       process while the write is in progress dirties it again. */
+    frame_set_dirty (p->frame, false);
+    if (p->file != NULL && !p->private)
+        ok = file_write_at (p->file, p->frame->base, p->file_bytes,
+                            p->file_offset) == p->file_bytes;
+    else if ((ok = swap_out (p)))
+        sharers_follow_swap (p);
+
+    if (!ok)
+        frame_set_dirty (p->frame, true);
+    return ok;
+}
+
+/* Returns true if page P, or any page sharing its frame, has been
+   accessed since the last call, clearing their accessed bits.  P's
+   frame must be locked. */
+bool
+page_accessed_recently (struct page *p)
+{
+    struct page *s;
+    bool was_accessed = false;
+
+    ASSERT (p->frame != NULL);
+    ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+    for (s = p->frame->page; s != NULL; s = s->next_sharer)
+        if (pagedir_is_accessed (s->thread->pagedir, s->addr))
+        {
+            pagedir_set_accessed (s->thread->pagedir, s->addr, false);
+            was_accessed = true;
+        }
+    return was_accessed;
+}
+
+/* Brings the page containing ADDR into memory, if necessary, and
+   keeps its frame locked so that it cannot be evicted until
+   page_unlock().  Fails if ADDR has no page or WILL_WRITE is set
+   for a read-only page. */
+bool
+page_lock (const void *addr, bool will_write)
+{
+    struct page *p = find_page (addr);
+    if (p == NULL || (p->read_only && will_write))
         return false;
 
-    struct page *new_page = malloc(sizeof(struct page));
-    if (!new_page)
+    frame_lock (p);
+    if (p->frame != NULL)
+    {
+        if (will_write && p->cow && !page_break_cow (p))
+        {
+            frame_unlock (p);
+            return false;
+        }
+        return true;
+    }
+
+    if (!do_page_in (p))
+        return false;
+    if (!page_install (p))
+    {
+        frame_unlock (p);
         return false;
+    }
+    return true;
+}
 
-    new_page->addr = pg_round_down(user_addr);
-    new_page->thread = thread_current ();
-    new_page->read_only = false;
+/* Unlocks the frame of the page containing ADDR, which must have
+   been locked with page_lock(). */
+void
+page_unlock (const void *addr)
+{
+    struct page *p = find_page (addr);
+    ASSERT (p != NULL);
+    frame_unlock (p);
+}
+
+/* Returns page P if it is resident in a frame that the running
+   thread has locked already, or a null pointer otherwise.  P's frame
+   cannot change under us while we hold its lock. */
+static struct page *
+page_held (struct page *p)
+{
+    struct frame *f = p != NULL ? p->frame : NULL;
+
+    return f != NULL && lock_held_by_current_thread (&f->lock) ? p : NULL;
+}
+
+/* Locks every page of the SIZE-byte user buffer at UADDR into
+   memory with page_lock(), growing the stack for pages just below
+   the user stack pointer, so that kernel code can access the buffer
+   without faulting.  WRITABLE says whether the kernel will store
+   into the buffer.  A page whose frame is locked already, because
+   it shares the frame with a page before it in the buffer (see
+   merge.c and share.c), is left as it is.  Returns true if
+   successful; on failure, including a buffer that reaches
+   PHYS_BASE, no page of the buffer is left locked. */
+bool
+page_pin_range (const void *uaddr, size_t size, bool writable)
+{
+    const uint8_t *start = pg_round_down (uaddr);
+    const uint8_t *end = (const uint8_t *) uaddr + size;
+    const uint8_t *upage;
+
+    /* Only user pages may be locked or grown into; this also catches
+       a size that wraps around the address space. */
+    if (end < (const uint8_t *) uaddr || end > (const uint8_t *) PHYS_BASE)
+        return false;
+
+    for (upage = start; upage < end; upage += PGSIZE)
+    {
+        void *esp = thread_current ()->user_esp;
+        struct page *held;
+
+        if (find_page (upage) == NULL
+            && (const void *) upage + PGSIZE > esp - 32)
+            stack_grow ((void *) upage, writable);
+
+        held = page_held (find_page (upage));
+        if (held != NULL)
+        {
+            /* Pages sharing a writable pinned frame are never
+               copy-on-write, so this does not happen in practice. */
+            if (writable && held->cow)
+            {
+                page_unpin_range (start, upage - start);
+                return false;
+            }
+            continue;
+        }
+
+        if (!page_lock (upage, writable))
+        {
+            page_unpin_range (start, upage - start);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Unlocks the pages of the SIZE-byte user buffer at UADDR, which
+   must have been locked with page_pin_range().  Each shared frame
+   is unlocked once, for the first of its pages. */
+void
+page_unpin_range (const void *uaddr, size_t size)
+{
+    const uint8_t *end = (const uint8_t *) uaddr + size;
+    const uint8_t *upage;
+
+    for (upage = pg_round_down (uaddr); upage < end; upage += PGSIZE)
+        if (page_held (find_page (upage)) != NULL)
+            page_unlock (upage);
+}
+
+/* Returns true if UPAGE is a user page that a stack page may occupy
+   without growing the stack beyond STACK_LIMIT. */
+static bool
+stack_within_limit (const uint8_t *upage)
+{
+    return is_user_vaddr (upage)
+           && (size_t) ((uint8_t *) PHYS_BASE - upage) <= STACK_LIMIT;
+}
+
+/* Adds a stack page at USER_ADDR, if the stack may grow that far,
+   and maps it: to the zero frame unless WRITE says the fault that
+   grew the stack was a write.  While stack faults keep landing just
+   below the previous growth, as in deep recursion, the number of
+   pages grown per fault doubles up to STACK_GROW_MAX, the extra
+   ones getting zeroed frames right away; a fault elsewhere starts
+   over at one page.  Returns true if successful. */
+bool
+stack_grow (void *user_addr, bool write)
+{
+    struct thread *t = thread_current ();
+    uint8_t *upage = pg_round_down (user_addr);
+    uint8_t *bottom = t->stack_bottom;
+    size_t i;
+
+    if (!stack_within_limit (upage))
+        return false;
+
+    struct page *p = page_allocate (upage, false);
+    if (p == NULL)
+        return false;
+    vm_stats.stack_faults++;
+
+    if (bottom != NULL && upage < bottom && bottom - upage <= STACK_NEAR)
+        t->stack_window = t->stack_window == 0 ? 2 : t->stack_window * 2;
+    else
+        t->stack_window = 1;
+    if (t->stack_window > STACK_GROW_MAX)
+        t->stack_window = STACK_GROW_MAX;
+
+    if (!(write ? page_map (p) : page_map_zero (p)))
+        return false;
+    t->stack_bottom = upage;
+
+    for (i = 1; i < t->stack_window; i++)
+    {
+        uint8_t *ahead = upage - i * PGSIZE;
+        struct page *n;
+
+        if (!stack_within_limit (ahead) || find_page (ahead) != NULL
+            || !frame_can_spare (t, 1))
+            break;
+        n = page_allocate (ahead, false);
+        if (n == NULL || !page_map (n))
+            break;
+        vm_stats.stack_ahead++;
+        t->stack_bottom = ahead;
+    }
+    return true;
+}
+
+/* Reserves the running process's initial stack below the page
+   setup_stack() mapped: the process's stack_reserve pages, or the
+   kernel default, capped at STACK_LIMIT.  Reserved pages get frames
+   only when touched, but accesses to them are never mistaken for
+   wild ones however far below the stack pointer they are.  Returns
+   true if successful. */
+bool
+page_reserve_stack (void)
+{
+    struct thread *t = thread_current ();
+    size_t pages = t->stack_reserve != 0 ? t->stack_reserve
+                                         : default_stack_reserve;
+    uint8_t *bottom = (uint8_t *) PHYS_BASE - PGSIZE;
+    size_t i;
 
-    /* TODO: Install page to frame */
-    void *frame_for_new_page = NULL; // Replace with allocated frame
-    if (frame_for_new_page != NULL)
+    for (i = 1; i < pages; i++)
     {
-        free(new_page);
+        uint8_t *upage = bottom - PGSIZE;
+
+        if (!stack_within_limit (upage))
+            break;
+        if (page_allocate (upage, false) == NULL)
+            return false;
+        bottom = upage;
+    }
+    t->stack_bottom = bottom;
+    return true;
+}
+
+/* Applies ADVICE, one of the MADV_* hints, to the running process's
+   pages in the LENGTH bytes at ADDR.  MADV_WILLNEED reads in the
+   pages that are not resident, as long as frames are free for them;
+   MADV_DONTNEED discards the pages' contents (see page_discard());
+   the others record the access pattern that page_fault_around()
+   follows.  Returns false if ADVICE is unknown. */
+bool
+page_advise (void *addr, size_t length, int advice)
+{
+    struct thread *t = thread_current ();
+    uint8_t *end = (uint8_t *) addr + length;
+    uint8_t *upage;
+
+    if (advice < MADV_NORMAL || advice > MADV_DONTNEED)
         return false;
+
+    for (upage = pg_round_down (addr); upage < end; upage += PGSIZE)
+    {
+        struct page *p = find_page (upage);
+        if (p == NULL)
+            continue;
+
+        switch (advice)
+        {
+            case MADV_WILLNEED:
+                if (p->frame == NULL && !p->zero_mapped
+                    && (p->file != NULL || p->sector != (block_sector_t) -1))
+                {
+                    if (!frame_can_spare (t, 1))
+                        return true;
+                    page_map (p);
+                }
+                break;
+            case MADV_DONTNEED:
+                page_discard (p);
+                break;
+            default:
+                p->advice = advice;
+                break;
+        }
     }
+    return true;
+}
+
+/* Writes the running process's dirty pages of shared file mappings
+   in the LENGTH bytes at ADDR back to their files, leaving them
+   mapped.  Returns false if any write failed. */
+bool
+page_sync (void *addr, size_t length)
+{
+    uint8_t *end = (uint8_t *) addr + length;
+    uint8_t *upage;
+    bool ok = true;
 
-    if (!install_page(new_page->addr, frame_for_new_page, new_page->read_only))
+    for (upage = pg_round_down (addr); upage < end; upage += PGSIZE)
     {
-        free(new_page);
-        // TODO: Free frame_for_new_page
+        struct page *p = find_page (upage);
+        if (p == NULL || p->file == NULL || p->private)
+            continue;
+
+        frame_lock (p);
+        if (p->frame != NULL && p->frame->page == p && !page_clean (p))
+            ok = false;
+        frame_unlock (p);
+    }
+    return ok;
+}
+
+/* For the same-page merging thread, remaps page P, the only page
+   of its frame, copy-on-write to frame TARGET if TARGET holds the
+   same bytes, and frees P's old frame.  P and the pages already
+   mapping TARGET are write-protected first, so that the comparison
+   cannot be overtaken by a write; if it fails, P is made writable
+   again.  Both frames must be locked by the caller.  Returns true if
+   P was merged, in which case its old frame has been freed and
+   unlocked; otherwise it stays locked. */
+bool
+page_merge (struct page *p, struct frame *target)
+{
+    uint32_t *pd = p->thread->pagedir;
+    struct page *s;
+    bool writable;
+    bool dirty;
+
+    ASSERT (p->frame->page == p && p->next_sharer == NULL);
+    ASSERT (lock_held_by_current_thread (&p->frame->lock));
+    ASSERT (lock_held_by_current_thread (&target->lock));
+
+    for (s = target->page; s != NULL; s = s->next_sharer)
+        if (!s->cow && !s->read_only)
+        {
+            pagedir_set_writable (s->thread->pagedir, s->addr, false);
+            s->cow = true;
+        }
+
+    /* A store to P while it is writable could land after the
+       comparison and be lost.  A store once it is protected faults
+       and waits for P's frame lock. */
+    writable = !p->cow && pagedir_get_page (pd, p->addr) != NULL;
+    if (writable)
+        pagedir_set_writable (pd, p->addr, false);
+    if (memcmp (p->frame->base, target->base, PGSIZE))
+    {
+        if (writable)
+            pagedir_set_writable (pd, p->addr, true);
         return false;
     }
 
-    return (hash_insert(&thread_current()->pages, &new_page->hash_elem) == NULL);
-}
\ No newline at end of file
+    /* The shared frame must not be taken for clean on P's behalf
+       if P was not.  P can no longer be written, so its dirty bit is
+       final. */
+    dirty = pagedir_is_dirty (pd, p->addr);
+    pagedir_clear_page (pd, p->addr);
+    frame_unshare (p);
+
+    frame_add_sharer (target, p);
+    p->cow = true;
+    if (pagedir_set_page (pd, p->addr, target->base, false) && dirty)
+        pagedir_set_dirty (pd, p->addr, true);
+    vm_stats.merged_pages++;
+    return true;
+}
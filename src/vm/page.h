@@ -1,16 +1,34 @@
 #ifndef PAGE_H
 #define PAGE_H
 
+#include <debug.h>
 #include <stdint.h>
-#include <hash.h>
 #include "threads/palloc.h"
 #include "filesys/file.h"
 #include "vm/frame.h"
 #include "threads/synch.h"
 #include "devices/block.h"
+#include "threads/loader.h"
+#include "threads/pte.h"
 
 #define STACK_LIMIT (1 << 23)
 
+struct thread;
+
+/* Entries in a page table's directory, one per page directory
+   entry below PHYS_BASE, and in each of its tables. */
+#define PAGE_DIR_CNT (LOADER_PHYS_BASE >> PDSHIFT)
+#define PAGE_TABLE_CNT (1 << PTBITS)
+
+/* Supplemental page table of a process.  Laid out like the
+   hardware page directory, so that finding a page takes two loads:
+   each directory entry is null or points to a page of
+   PAGE_TABLE_CNT page pointers. */
+struct page_table
+  {
+    struct page **tables[PAGE_DIR_CNT];
+  };
+
 /* Virtual page. */
 struct page
   {
@@ -20,27 +38,54 @@ struct page
     struct thread *thread;      /* Owning thread. */
 
     /* Accessed only in owning process context. */
-    struct hash_elem hash_elem; /* struct thread `pages' hash element. */
+    bool zero_mapped;           /* Mapped read-only to the zero frame? */
+    uint8_t advice;             /* Access pattern, a MADV_* hint. */
 
-    /* Set only in owning process context with frame->lock held.
-       Cleared only with scan_lock and frame->lock held. */
+    /* Set only in owning process context with frame->lock held, or
+       by the same-page merging thread with the old and new frames'
+       locks held.  Cleared only with frame->lock held. */
     struct frame *frame;        /* Page frame. */
 
-    /* Swap information, protected by frame->lock. */
+    /* Protected by frame->lock. */
+    struct page *next_sharer;   /* Next page mapping the same frame. */
+    bool cow;                   /* Mapped read-only until written? */
+
+    /* Swap information, protected by frame->lock.  A resident page
+       may hold a slot too, as a copy of its frame while not dirty. */
     block_sector_t sector;       /* Starting sector of swap area, or -1. */
 
-    /* Memory-mapped file information, protected by frame->lock. */
+    /* Memory-mapped file information, protected by frame->lock.  The
+       file stays the page's origin after a private page goes to swap,
+       so that discarding the page reads it from the file again. */
     bool private;               /* False to write back to file, true to write back to swap. */
     struct file *file;          /* File. */
     off_t file_offset;          /* Offset in file. */
     off_t file_bytes;           /* Bytes to read/write, 1...PGSIZE. */
+    bool file_stale;            /* Data moved to swap, so the file no
+                                   longer holds it? */
   };
 
-void page_table_intialization(struct hash*ptr);
-bool page_hash_less_function(const struct hash_elem*first, const struct hash_elem*second, void *aux UNUSED);
-void page_hash_action_function(struct hash_elem*el, void *aux UNUSED);
-unsigned page_hash_hash_function(const struct hash_elem*el, void*aux UNUSED);
-struct page *find_page(void*addr);
+void page_init(size_t stack_pages);
+struct page_table *page_table_create(void);
+void page_table_destroy(struct page_table *pt);
+bool page_table_fork(struct thread *parent, struct file *exe);
+struct page *find_page(const void*addr);
+struct page *page_neighbor(const struct page *page, int delta);
+struct page *page_allocate(void *vaddr, bool read_only);
+void page_deallocate(void *vaddr);
+bool page_in(void *fault_addr, bool write, uint64_t start);
+bool page_out(struct page *page);
+bool page_clean(struct page *page);
+bool page_accessed_recently(struct page *page);
+bool page_lock(const void *addr, bool will_write);
+void page_unlock(const void *addr);
+bool page_pin_range(const void *uaddr, size_t size, bool writable);
+void page_unpin_range(const void *uaddr, size_t size);
+bool stack_grow(void *user_addr, bool write);
+bool page_reserve_stack(void);
+bool page_advise(void *addr, size_t length, int advice);
+bool page_sync(void *addr, size_t length);
+bool page_merge(struct page *page, struct frame *target);
 
 
 #endif // PAGE_H
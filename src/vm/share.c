@@ -0,0 +1,124 @@
+#include "vm/share.h"
+#include <debug.h>
+#include <hash.h>
+#include "filesys/inode.h"
+#include "threads/synch.h"
+
+/* Read-only file-backed frames, keyed by the sector of the file's
+   inode, the offset within it and the number of bytes read, so that
+   processes running the same program map one copy of each text
+   page.  The byte count tells apart a segment's partial last page
+   from a full page at the same offset in the next segment, whose
+   contents differ past the partial page's zero fill.
+
+   Lock order: a frame's lock may be held while acquiring
+   share_lock, so share_find() only ever tries frame locks. */
+static struct hash share_table;
+static struct lock share_lock;
+
+/* Returns the sector of the inode of page P's file. */
+static block_sector_t
+page_inumber (const struct page *p)
+{
+  return inode_get_inumber (file_get_inode (p->file));
+}
+
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, share_elem);
+  return (hash_int (f->share_sector) ^ hash_int (f->share_offset)
+          ^ hash_int (f->share_bytes));
+}
+
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, share_elem);
+  const struct frame *b = hash_entry (b_, struct frame, share_elem);
+
+  if (a->share_sector != b->share_sector)
+    return a->share_sector < b->share_sector;
+  if (a->share_offset != b->share_offset)
+    return a->share_offset < b->share_offset;
+  return a->share_bytes < b->share_bytes;
+}
+
+/* Initializes the shared frame cache. */
+void
+share_init (void)
+{
+  hash_init (&share_table, share_hash, share_less, NULL);
+  lock_init (&share_lock);
+}
+
+/* Returns true if page P may map a frame shared with other
+   processes: it is a read-only page that comes from a file. */
+bool
+share_eligible (const struct page *p)
+{
+  return p->read_only && p->file != NULL && !p->file_stale
+         && p->sector == (block_sector_t) -1;
+}
+
+/* Looks for a resident frame holding the data of page P, which
+   must be eligible for sharing.  Returns the frame locked by the
+   caller, or a null pointer if there is none or it is busy. */
+struct frame *
+share_find (const struct page *p)
+{
+  struct frame key;
+  struct hash_elem *e;
+  struct frame *f = NULL;
+
+  key.share_sector = page_inumber (p);
+  key.share_offset = p->file_offset;
+  key.share_bytes = p->file_bytes;
+
+  lock_acquire (&share_lock);
+  e = hash_find (&share_table, &key.share_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, share_elem);
+      if (lock_held_by_current_thread (&f->lock)
+          || !lock_try_acquire (&f->lock))
+        f = NULL;
+    }
+  lock_release (&share_lock);
+  return f;
+}
+
+/* Offers frame F, which must be locked by the caller and hold a
+   freshly read page eligible for sharing, to later share_find()
+   calls.  Does nothing if another frame already holds the data. */
+void
+share_add (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (share_eligible (f->page));
+
+  f->share_sector = page_inumber (f->page);
+  f->share_offset = f->page->file_offset;
+  f->share_bytes = f->page->file_bytes;
+
+  lock_acquire (&share_lock);
+  f->shared = hash_insert (&share_table, &f->share_elem) == NULL;
+  lock_release (&share_lock);
+}
+
+/* Withdraws frame F, which must be locked by the caller, from the
+   cache before it loses its data. */
+void
+share_remove (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  if (f->shared)
+    {
+      lock_acquire (&share_lock);
+      hash_delete (&share_table, &f->share_elem);
+      f->shared = false;
+      lock_release (&share_lock);
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef SHARE_H
+#define SHARE_H
+
+#include <stdbool.h>
+#include "vm/frame.h"
+#include "vm/page.h"
+
+void share_init (void);
+bool share_eligible (const struct page *);
+struct frame *share_find (const struct page *);
+void share_add (struct frame *);
+void share_remove (struct frame *);
+
+#endif // SHARE_H
@@ -1,17 +1,626 @@
-#include "swap.h"
+#include "vm/swap.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/lz.h"
+#include "vm/vmstat.h"
 
 /* Global swap device */
-struct block *swap_block;
+static struct block *swap_block;
 
 /* Global bitmap to keep track of open slots */
-struct bitmap *swap_bitmap;
+static struct bitmap *swap_bitmap;
 
-/* Global lock to protect the swap bitmap */
-struct lock swap_lock;
+/* Number of pages holding each slot.  A slot is held by more than
+   one page when a frame shared copy-on-write after fork() is
+   written out, or when fork() copies a swapped-out page. */
+static uint16_t *swap_refs;
 
-/* Number of sectors per page */
-#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+/* Number of slots in use. */
+static size_t swap_used_cnt;
+
+/* Global lock to protect the swap bitmap and reference counts,
+   and the compressed swap cache below */
+static struct lock swap_lock;
+
+/* Compressed swap cache.  A page written to swap is first offered
+   to it: if the page is filled with one repeated word, or
+   compresses to at most half a page, its slot's contents are kept
+   in kernel memory instead of being written to the device, so that
+   swapping it back in costs no I/O.  Once the cache holds more than
+   zswap_limit bytes, its oldest entries are written to their slots
+   on the device and dropped.  The slot stays allocated either way,
+   so reference counts and slot clustering work as for slots on the
+   device. */
+struct zpage
+  {
+    struct list_elem elem;      /* zswap_lru element. */
+    size_t slot;                /* Slot whose contents it holds. */
+    size_t size;                /* Bytes in DATA, 0 if same-filled. */
+    uint32_t fill;              /* Word repeated in a same-filled page. */
+    uint8_t data[];             /* Compressed page. */
+  };
+
+static struct zpage **swap_zpages;  /* Cache entry for each slot. */
+static struct list zswap_lru;       /* Entries, oldest first. */
+static size_t zswap_bytes;          /* Memory held by entries. */
+static size_t zswap_limit;          /* Most bytes to hold. */
+static uint8_t zswap_buf[PGSIZE / 2]; /* Compression output. */
+static struct lz_work zswap_work;   /* Compression scratch space. */
+
+/* Batched writes.  Between swap_batch_begin() and swap_batch_end(),
+   swap_out() only records the device writes it would make, and
+   swap_batch_end() then makes them in slot order, each run of
+   adjacent slots with a single request, instead of a request per
+   sector.  The frames whose writes are pending stay locked by the
+   batch's owner until it ends.  The batch holds a reference to each
+   recorded slot, so that it is not reused before it is written, and
+   swap_in_cluster() waits for the batch to end before reading a slot
+   it holds. */
+struct swap_write
+  {
+    size_t slot;                /* Slot to write. */
+    void *kpage;                /* Page to write there. */
+  };
+
+static struct lock batch_lock;      /* Held by the batch's owner. */
+static struct swap_write batch[SWAP_BATCH_MAX]; /* Pending writes,
+                                       protected by swap_lock. */
+static size_t batch_cnt;            /* Entries in BATCH. */
+static void *batch_sectors[SWAP_BATCH_MAX * PAGE_SECTORS];
+                                    /* Request buffers, owner only. */
 
 /* Bit for each slot */
 #define SWAP_EMPTY 0
 #define SWAP_FULL 1
+
+/* Sets up the swap area on the block device playing the BLOCK_SWAP
+   role.  Without one, swap is disabled and every swap_out() fails.
+   ZSWAP_PAGES is the most kernel memory, in pages, that compressed
+   swapped-out pages may take, or SIZE_MAX to use an eighth of the
+   user pool's size; 0 disables compression. */
+void
+swap_init (size_t zswap_pages)
+{
+  swap_block = block_get_role (BLOCK_SWAP);
+  if (swap_block == NULL)
+    {
+      printf ("no swap device--swap disabled\n");
+      swap_bitmap = bitmap_create (0);
+    }
+  else
+    swap_bitmap = bitmap_create (block_size (swap_block) / PAGE_SECTORS);
+
+  if (swap_bitmap == NULL)
+    PANIC ("couldn't create swap bitmap");
+  swap_refs = calloc (bitmap_size (swap_bitmap), sizeof *swap_refs);
+  if (swap_refs == NULL && bitmap_size (swap_bitmap) > 0)
+    PANIC ("couldn't create swap reference counts");
+  swap_zpages = calloc (bitmap_size (swap_bitmap), sizeof *swap_zpages);
+  if (swap_zpages == NULL && bitmap_size (swap_bitmap) > 0)
+    PANIC ("couldn't create compressed swap cache");
+  list_init (&zswap_lru);
+  if (zswap_pages == SIZE_MAX)
+    zswap_pages = palloc_user_page_cnt () / 8;
+  zswap_limit = zswap_pages * PGSIZE;
+  lock_init (&swap_lock);
+  lock_init (&batch_lock);
+}
+
+/* Points SECTORS[0] through SECTORS[PAGE_SECTORS - 1] at the
+   successive sectors of the page at KPAGE.  Returns PAGE_SECTORS. */
+static size_t
+page_sectors (void *kpage, void *sectors[])
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SECTORS; i++)
+    sectors[i] = (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE;
+  return PAGE_SECTORS;
+}
+
+/* Reads the CNT swap sectors starting at SECTOR into SECTORS, with
+   one request to the swap device. */
+static void
+swap_read_sectors (block_sector_t sector, void *const sectors[], size_t cnt)
+{
+  block_read_multi (swap_block, sector, sectors, cnt);
+  vm_stats.swap_reads += cnt;
+  vm_stats.swap_read_cmds++;
+}
+
+/* Writes SECTORS to the CNT swap sectors starting at SECTOR, with
+   one request to the swap device. */
+static void
+swap_write_sectors (block_sector_t sector, void *const sectors[], size_t cnt)
+{
+  block_write_multi (swap_block, sector, (const void *const *) sectors, cnt);
+  vm_stats.swap_writes += cnt;
+  vm_stats.swap_write_cmds++;
+}
+
+/* Returns true if the page at KPAGE consists of one 32-bit word
+   repeated, storing the word in *FILL. */
+static bool
+page_is_same_filled (const void *kpage, uint32_t *fill)
+{
+  const uint32_t *words = kpage;
+  size_t i;
+
+  for (i = 1; i < PGSIZE / sizeof *words; i++)
+    if (words[i] != words[0])
+      return false;
+  *fill = words[0];
+  return true;
+}
+
+/* Drops the compressed swap cache's entry for SLOT, if any.
+   swap_lock must be held. */
+static void
+zswap_drop (size_t slot)
+{
+  struct zpage *z = swap_zpages[slot];
+
+  if (z != NULL)
+    {
+      list_remove (&z->elem);
+      zswap_bytes -= sizeof *z + z->size;
+      free (z);
+      swap_zpages[slot] = NULL;
+    }
+}
+
+/* Tries to keep the page at KPAGE in the compressed swap cache as
+   the contents of SLOT, replacing any older entry for it.  Returns
+   true if successful, false if the cache is disabled or the page
+   does not compress well enough.  swap_lock must be held. */
+static bool
+zswap_store (size_t slot, const void *kpage)
+{
+  struct zpage *z;
+  uint32_t fill = 0;
+  size_t size = 0;
+
+  if (zswap_limit == 0)
+    return false;
+  if (!page_is_same_filled (kpage, &fill))
+    {
+      size = lz_compress (kpage, PGSIZE, zswap_buf, sizeof zswap_buf,
+                          &zswap_work);
+      if (size == 0)
+        return false;
+    }
+
+  z = malloc (sizeof *z + size);
+  if (z == NULL)
+    return false;
+  z->slot = slot;
+  z->size = size;
+  z->fill = fill;
+  memcpy (z->data, zswap_buf, size);
+
+  zswap_drop (slot);
+  swap_zpages[slot] = z;
+  list_push_back (&zswap_lru, &z->elem);
+  zswap_bytes += sizeof *z + size;
+  if (size == 0)
+    vm_stats.zswap_same++;
+  vm_stats.zswap_stores++;
+  return true;
+}
+
+/* Copies compressed swap cache entry Z's page into KPAGE. */
+static void
+zswap_copy (const struct zpage *z, void *kpage)
+{
+  if (z->size == 0)
+    {
+      uint32_t *words = kpage;
+      size_t i;
+
+      for (i = 0; i < PGSIZE / sizeof *words; i++)
+        words[i] = z->fill;
+    }
+  else if (lz_decompress (z->data, z->size, kpage, PGSIZE) != PGSIZE)
+    PANIC ("corrupt compressed swap page");
+}
+
+/* Frees SLOT, which no page or swap batch holds any longer, and
+   drops its compressed copy, if any.  swap_lock must be held. */
+static void
+slot_release (size_t slot)
+{
+  bitmap_reset (swap_bitmap, slot);
+  zswap_drop (slot);
+  swap_used_cnt--;
+}
+
+/* Writes the oldest entries of the compressed swap cache to their
+   slots on the swap device and drops them, until the cache is back
+   within its limit.  While an entry is being written it holds a
+   reference to its slot, so that the slot is neither freed nor
+   rewritten in place meanwhile, and it can still be read. */
+static void
+zswap_shrink (void)
+{
+  void *bounce = NULL;
+  void *sectors[PAGE_SECTORS];
+
+  lock_acquire (&swap_lock);
+  while (zswap_bytes > zswap_limit && !list_empty (&zswap_lru))
+    {
+      struct zpage *z;
+      size_t slot;
+
+      if (bounce == NULL)
+        {
+          lock_release (&swap_lock);
+          bounce = palloc_get_page (0);
+          lock_acquire (&swap_lock);
+          if (bounce == NULL)
+            break;
+          continue;
+        }
+
+      z = list_entry (list_pop_front (&zswap_lru), struct zpage, elem);
+      slot = z->slot;
+      swap_refs[slot]++;
+      zswap_copy (z, bounce);
+      lock_release (&swap_lock);
+
+      swap_write_sectors (slot * PAGE_SECTORS, sectors,
+                          page_sectors (bounce, sectors));
+      vm_stats.zswap_writebacks++;
+
+      lock_acquire (&swap_lock);
+      ASSERT (swap_zpages[slot] == z);
+      zswap_bytes -= sizeof *z + z->size;
+      free (z);
+      swap_zpages[slot] = NULL;
+      if (--swap_refs[slot] == 0)
+        slot_release (slot);
+    }
+  lock_release (&swap_lock);
+  palloc_free_page (bounce);
+}
+
+/* Reads page P's contents back from its swap slot into its frame,
+   which must be locked by the caller, as swap_in_cluster() does. */
+void
+swap_in (struct page *p)
+{
+  swap_in_cluster (&p, 1);
+}
+
+/* Returns true if a write to SLOT is pending in the current swap
+   batch.  swap_lock must be held. */
+static bool
+slot_is_pending (size_t slot)
+{
+  size_t i;
+
+  for (i = 0; i < batch_cnt; i++)
+    if (batch[i].slot == slot)
+      return true;
+  return false;
+}
+
+/* Reads the CNT pages in PAGES, at most SWAP_CLUSTER, which hold
+   adjacent swap slots in increasing order, back into their frames,
+   which must be locked by the caller.  Pages in the compressed swap
+   cache are decompressed and release their slots, so as not to take
+   up memory twice.  Each run of the other pages is read with a
+   single request to the swap device.  While swap is at most half
+   full, those pages keep their slots as clean copies of their
+   contents, so that evicting one again before it is written needs
+   no I/O (see page_out()); otherwise they release them too. */
+void
+swap_in_cluster (struct page **pages, size_t cnt)
+{
+  void *sectors[SWAP_CLUSTER * PAGE_SECTORS];
+  bool from_zswap[SWAP_CLUSTER];
+  block_sector_t sector;
+  block_sector_t run_start = 0;
+  size_t run_cnt = 0;
+  bool pending = false;
+  bool keep;
+  struct zpage *z;
+  size_t i;
+
+  ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
+  sector = pages[0]->sector;
+
+  /* A slot still waiting for its batched write must not be read
+     before the batch ends. */
+  lock_acquire (&swap_lock);
+  for (i = 0; i < cnt; i++)
+    pending = pending || slot_is_pending (pages[i]->sector / PAGE_SECTORS);
+  lock_release (&swap_lock);
+  if (pending)
+    {
+      lock_acquire (&batch_lock);
+      lock_release (&batch_lock);
+    }
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *p = pages[i];
+
+      ASSERT (p->frame != NULL);
+      ASSERT (lock_held_by_current_thread (&p->frame->lock));
+      ASSERT (p->sector == sector + i * PAGE_SECTORS);
+
+      lock_acquire (&swap_lock);
+      z = swap_zpages[p->sector / PAGE_SECTORS];
+      if (z != NULL)
+        zswap_copy (z, p->frame->base);
+      lock_release (&swap_lock);
+      from_zswap[i] = z != NULL;
+      if (z != NULL)
+        {
+          vm_stats.zswap_loads++;
+          if (run_cnt > 0)
+            swap_read_sectors (run_start, sectors, run_cnt);
+          run_cnt = 0;
+          continue;
+        }
+
+      if (run_cnt == 0)
+        run_start = p->sector;
+      run_cnt += page_sectors (p->frame->base, sectors + run_cnt);
+    }
+  if (run_cnt > 0)
+    swap_read_sectors (run_start, sectors, run_cnt);
+
+  lock_acquire (&swap_lock);
+  keep = swap_used_cnt <= bitmap_size (swap_bitmap) / 2;
+  lock_release (&swap_lock);
+  for (i = 0; i < cnt; i++)
+    if (keep && !from_zswap[i])
+      vm_stats.swap_cached++;
+    else
+      swap_free (pages[i]);
+}
+
+/* Returns true if swap slot SLOT exists and is free.  swap_lock
+   must be held. */
+static bool
+slot_is_free (size_t slot)
+{
+  return slot < bitmap_size (swap_bitmap)
+         && bitmap_test (swap_bitmap, slot) == SWAP_EMPTY;
+}
+
+/* Chooses and marks a free slot for page P, whose frame is locked:
+   the slot next to that of P's neighbour in its process's address
+   space, if free, so that pages evicted together from neighbouring
+   addresses come back in together (see page.c); otherwise the first
+   slot of a free run of SWAP_CLUSTER slots, leaving the rest for its
+   neighbours; otherwise any free slot.  swap_lock must be held.
+   Returns BITMAP_ERROR if swap is full. */
+static size_t
+swap_pick_slot (const struct page *p)
+{
+  int delta;
+  size_t slot;
+
+  for (delta = -1; delta <= 1; delta += 2)
+    {
+      /* Only a hint: the neighbour may be changing meanwhile. */
+      const struct page *n = page_neighbor (p, delta);
+      block_sector_t sector = n != NULL ? n->sector : (block_sector_t) -1;
+
+      if (sector != (block_sector_t) -1)
+        {
+          slot = sector / PAGE_SECTORS - delta;
+          if (slot_is_free (slot))
+            {
+              bitmap_mark (swap_bitmap, slot);
+              return slot;
+            }
+        }
+    }
+
+  slot = bitmap_scan (swap_bitmap, 0, SWAP_CLUSTER, SWAP_EMPTY);
+  if (slot != BITMAP_ERROR)
+    {
+      bitmap_mark (swap_bitmap, slot);
+      return slot;
+    }
+  return bitmap_scan_and_flip (swap_bitmap, 0, 1, SWAP_EMPTY);
+}
+
+/* Makes the pending writes of the current swap batch, which the
+   running thread must own, and empties it. */
+static void
+swap_batch_flush (void)
+{
+  size_t i, j;
+
+  ASSERT (lock_held_by_current_thread (&batch_lock));
+
+  /* Sort by slot.  The batch is small. */
+  lock_acquire (&swap_lock);
+  for (i = 1; i < batch_cnt; i++)
+    {
+      struct swap_write w = batch[i];
+
+      for (j = i; j > 0 && batch[j - 1].slot > w.slot; j--)
+        batch[j] = batch[j - 1];
+      batch[j] = w;
+    }
+  lock_release (&swap_lock);
+
+  for (i = 0; i < batch_cnt; i = j)
+    {
+      size_t cnt = 0;
+
+      for (j = i; j < batch_cnt && batch[j].slot == batch[i].slot + (j - i);
+           j++)
+        cnt += page_sectors (batch[j].kpage, batch_sectors + cnt);
+      swap_write_sectors (batch[i].slot * PAGE_SECTORS, batch_sectors, cnt);
+    }
+
+  lock_acquire (&swap_lock);
+  for (i = 0; i < batch_cnt; i++)
+    {
+      size_t slot = batch[i].slot;
+
+      if (--swap_refs[slot] == 0)
+        slot_release (slot);
+    }
+  batch_cnt = 0;
+  lock_release (&swap_lock);
+}
+
+/* Records a pending write of the page at KPAGE to SLOT in the
+   current swap batch, which the running thread must own, first
+   making the batch's writes if it is full. */
+static void
+swap_batch_add (size_t slot, void *kpage)
+{
+  if (batch_cnt == SWAP_BATCH_MAX)
+    swap_batch_flush ();
+
+  lock_acquire (&swap_lock);
+  ASSERT (swap_refs[slot] < UINT16_MAX);
+  swap_refs[slot]++;
+  batch[batch_cnt].slot = slot;
+  batch[batch_cnt].kpage = kpage;
+  batch_cnt++;
+  lock_release (&swap_lock);
+}
+
+/* Starts a swap batch owned by the running thread, waiting for any
+   other batch to end first.  Until swap_batch_end(), the pages that
+   swap_out() sends to the device are written later, together; the
+   caller must keep their frames locked until then. */
+void
+swap_batch_begin (void)
+{
+  lock_acquire (&batch_lock);
+  ASSERT (batch_cnt == 0);
+}
+
+/* Makes the writes held back since swap_batch_begin() and ends the
+   batch. */
+void
+swap_batch_end (void)
+{
+  swap_batch_flush ();
+  lock_release (&batch_lock);
+}
+
+/* Writes page P's frame, which must be locked by the caller, to
+   swap and records the slot in P.  A page that already has a slot
+   of its own, because it was cleaned while resident or kept its slot
+   when it was swapped in, is rewritten in place; a slot held by other pages too is left to them.  The
+   page goes to the compressed swap cache if it will, otherwise to
+   the device, or to the current swap batch if the running thread
+   owns one.  Returns true if successful, false if swap is full. */
+bool
+swap_out (struct page *p)
+{
+  size_t slot;
+  bool stored;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  lock_acquire (&swap_lock);
+  if (p->sector != (block_sector_t) -1
+      && swap_refs[p->sector / PAGE_SECTORS] > 1)
+    {
+      swap_refs[p->sector / PAGE_SECTORS]--;
+      p->sector = (block_sector_t) -1;
+    }
+  if (p->sector == (block_sector_t) -1)
+    {
+      slot = swap_pick_slot (p);
+      if (slot == BITMAP_ERROR)
+        {
+          lock_release (&swap_lock);
+          return false;
+        }
+      swap_used_cnt++;
+      swap_refs[slot] = 1;
+      p->sector = slot * PAGE_SECTORS;
+    }
+  slot = p->sector / PAGE_SECTORS;
+  stored = zswap_store (slot, p->frame->base);
+  if (!stored)
+    zswap_drop (slot);
+  lock_release (&swap_lock);
+
+  if (stored)
+    zswap_shrink ();
+  else if (lock_held_by_current_thread (&batch_lock))
+    swap_batch_add (slot, p->frame->base);
+  else
+    {
+      void *sectors[PAGE_SECTORS];
+
+      swap_write_sectors (p->sector, sectors,
+                          page_sectors (p->frame->base, sectors));
+    }
+
+  /* From now on the page's contents live in swap, even if it was
+     originally a private file mapping.  The file is kept as the
+     page's origin (see page_discard()). */
+  p->file_stale = true;
+
+  return true;
+}
+
+/* Releases page P's hold on its swap slot, if it has one, freeing
+   the slot once no page holds it. */
+void
+swap_free (struct page *p)
+{
+  size_t slot;
+
+  if (p->sector == (block_sector_t) -1)
+    return;
+
+  slot = p->sector / PAGE_SECTORS;
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_bitmap, slot) == SWAP_FULL);
+  ASSERT (swap_refs[slot] > 0);
+  if (--swap_refs[slot] == 0)
+    slot_release (slot);
+  lock_release (&swap_lock);
+  p->sector = (block_sector_t) -1;
+}
+
+/* Makes page DST hold the same swap slot as page SRC, if SRC has
+   one.  DST must not hold a slot already. */
+void
+swap_dup (struct page *dst, const struct page *src)
+{
+  ASSERT (dst->sector == (block_sector_t) -1);
+
+  if (src->sector == (block_sector_t) -1)
+    return;
+
+  lock_acquire (&swap_lock);
+  ASSERT (swap_refs[src->sector / PAGE_SECTORS] < UINT16_MAX);
+  swap_refs[src->sector / PAGE_SECTORS]++;
+  lock_release (&swap_lock);
+  dst->sector = src->sector;
+}
+
+/* Stores the number of swap slots in use in *USED and the total
+   number of slots in *TOTAL. */
+void
+swap_slot_counts (unsigned *used, unsigned *total)
+{
+  lock_acquire (&swap_lock);
+  *total = bitmap_size (swap_bitmap);
+  *used = swap_used_cnt;
+  lock_release (&swap_lock);
+}
@@ -2,15 +2,33 @@
 #define SWAP_H
 
 #include <bitmap.h>
+#include <stdbool.h>
 #include "vm/page.h"
 #include "vm/frame.h"
 #include "devices/block.h"
+#include "threads/vaddr.h"
 
 struct page;
 
+/* Number of sectors per page */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
 
-void init_swap(void);
-void swap_out(void *frame);
-void swap_in(void *frame);
+/* Most adjacent swap slots read by one swap-in (see page.c), and
+   the size of the free runs swap_out() starts new clusters in. */
+#define SWAP_CLUSTER 8
+
+/* Most pages whose writes a swap batch holds back (see swap.c).  A
+   full batch of adjacent slots still fits one IDE command. */
+#define SWAP_BATCH_MAX 32
+
+void swap_init (size_t zswap_pages);
+void swap_in (struct page *);
+void swap_in_cluster (struct page **, size_t cnt);
+bool swap_out (struct page *);
+void swap_free (struct page *);
+void swap_batch_begin (void);
+void swap_batch_end (void);
+void swap_dup (struct page *dst, const struct page *src);
+void swap_slot_counts (unsigned *used, unsigned *total);
 
 #endif // SWAP_H
@@ -0,0 +1,136 @@
+#include "vm/vmstat.h"
+#include <stdio.h>
+#include "vm/swap.h"
+
+struct vmstat vm_stats;
+
+/* Page fault latencies, bumped without locking like vm_stats. */
+static struct faultstat fault_stats;
+
+/* Names of the fault classes, for printing. */
+static const char *fault_class_names[FAULT_CLASS_CNT] =
+  {"zero", "swap", "file", "stack", "cow"};
+
+/* Returns the processor's timestamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns a timestamp for the start of a page fault, to be passed
+   to vmstat_fault_end(). */
+uint64_t
+vmstat_fault_begin (void)
+{
+  return rdtsc ();
+}
+
+/* Records that a page fault of class CLASS, which began at START,
+   has been resolved. */
+void
+vmstat_fault_end (enum fault_class class, uint64_t start)
+{
+  uint64_t cycles = rdtsc () - start;
+  uint64_t c;
+  int bucket = 0;
+
+  for (c = cycles; c > 1 && bucket < FAULT_LAT_BUCKETS - 1; c >>= 1)
+    bucket++;
+  fault_stats.hist[class][bucket]++;
+  fault_stats.cycles[class] += cycles;
+}
+
+/* Copies the current fault latency histograms into *STATS. */
+void
+vmstat_fault_snapshot (struct faultstat *stats)
+{
+  *stats = fault_stats;
+}
+
+/* Returns the upper bound, in cycles, of the histogram bucket
+   below which fraction PERMILLE/1000 of the CNT faults in HIST
+   fall. */
+static unsigned long long
+fault_percentile (const unsigned hist[], unsigned long long cnt,
+                  unsigned permille)
+{
+  unsigned long long seen = 0;
+  int i;
+
+  for (i = 0; i < FAULT_LAT_BUCKETS - 1; i++)
+    {
+      seen += hist[i];
+      if (seen * 1000 >= cnt * permille)
+        break;
+    }
+  return (2ULL << i) - 1;
+}
+
+/* Prints the fault latency histogram of each class that has seen
+   any faults, as "2^I:COUNT" pairs. */
+static void
+fault_print_stats (void)
+{
+  int c, i;
+
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    {
+      const unsigned *hist = fault_stats.hist[c];
+      unsigned long long cnt = 0;
+
+      for (i = 0; i < FAULT_LAT_BUCKETS; i++)
+        cnt += hist[i];
+      if (cnt == 0)
+        continue;
+
+      printf ("Fault latency: %s: %llu faults, mean %llu cycles, "
+              "p50 < %llu, p99 < %llu;",
+              fault_class_names[c], cnt,
+              (unsigned long long) fault_stats.cycles[c] / cnt,
+              fault_percentile (hist, cnt, 500),
+              fault_percentile (hist, cnt, 990));
+      for (i = 0; i < FAULT_LAT_BUCKETS; i++)
+        if (hist[i] != 0)
+          printf (" 2^%d:%u", i, hist[i]);
+      printf ("\n");
+    }
+}
+
+/* Copies the current statistics into *STATS. */
+void
+vmstat_snapshot (struct vmstat *stats)
+{
+  *stats = vm_stats;
+  swap_slot_counts (&stats->swap_slots_used, &stats->swap_slots);
+}
+
+/* Prints virtual memory statistics. */
+void
+vmstat_print_stats (void)
+{
+  struct vmstat s;
+
+  vmstat_snapshot (&s);
+  printf ("VM: %lld faults: %lld stack, %lld file, %lld swap, "
+          "%lld zero, %lld invalid; %lld pages faulted around\n",
+          s.faults, s.stack_faults, s.file_faults, s.swap_faults,
+          s.zero_faults, s.invalid_faults, s.fault_around);
+  printf ("VM: %lld stack pages grown ahead of faults\n", s.stack_ahead);
+  printf ("VM: %lld pages mapped to shared frames, "
+          "%lld copy-on-write faults, %lld pages merged\n",
+          s.shared_maps, s.cow_faults, s.merged_pages);
+  printf ("VM: %lld clean evictions, %lld dirty evictions\n",
+          s.clean_evictions, s.dirty_evictions);
+  printf ("Swap: %u of %u slots in use, %lld sectors read "
+          "(%lld commands), %lld sectors written (%lld commands), "
+          "%lld pages read ahead, %lld kept their slots\n",
+          s.swap_slots_used, s.swap_slots, s.swap_reads, s.swap_read_cmds,
+          s.swap_writes, s.swap_write_cmds, s.swap_readahead, s.swap_cached);
+  printf ("Swap: %lld pages compressed in memory (%lld same-filled), "
+          "%lld read back, %lld written to disk\n",
+          s.zswap_stores, s.zswap_same, s.zswap_loads, s.zswap_writebacks);
+  fault_print_stats ();
+}
@@ -0,0 +1,18 @@
+#ifndef VMSTAT_H
+#define VMSTAT_H
+
+#include <stdint.h>
+#include "lib/user/syscall.h"
+
+/* Virtual memory statistics.  Counters are bumped without locking,
+   like page_fault_cnt, so they are approximate under contention. */
+extern struct vmstat vm_stats;
+
+void vmstat_snapshot (struct vmstat *);
+void vmstat_print_stats (void);
+
+uint64_t vmstat_fault_begin (void);
+void vmstat_fault_end (enum fault_class, uint64_t start);
+void vmstat_fault_snapshot (struct faultstat *);
+
+#endif // VMSTAT_H